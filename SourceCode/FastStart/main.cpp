@@ -0,0 +1,383 @@
+// main.cpp of FastStart program
+//
+//  Rewrite MP4 videos so the moov box (the index of the movie) comes before the movie data.
+//  Many rips put moov at the end of the file.  Read cold from a USB flash drive, the player then has to
+//  seek to the end of the file and read the index before it can show the first frame.  After FastStart
+//  the index is read together with the start of the file.
+//
+//  FastStart reads the same list file as PlayVideo (environment variable DVDLISTFILE, or the file named
+//  on the command line) and looks at every video in it.  Videos with moov at the end are rewritten:
+//     ftyp  free  mdat  moov     becomes     ftyp  moov  free  mdat
+//  and every chunk offset in the stco/co64 boxes is moved by the size of moov.  The new file is written
+//  next to the old one under a temporary name and renamed over it only after it checks out, so a power
+//  cut leaves either the old file or the new one.  The movie data is copied with copy_file_range (or
+//  sendfile) so it never passes through this program; only moov is held in memory.
+//  Each flash drive is handled by its own thread.
+//
+//  Usage:  FastStart [-n] [-b] [list file]
+//     -n   look only.  Report which videos have moov at the end but do not change them.
+//     -b   benchmark.  Time to first frame data from a cold cache, before and after.
+//
+//  Build:  g++ -O2 -D_FILE_OFFSET_BITS=64 main.cpp ../PlayVideo/ListManager.cpp ../PlayVideo/Mp4Probe.cpp -lwiringPi -lpthread -o FastStart
+//  then copy FastStart to /usr/bin.  Run it while PlayVideo is stopped, and make sure each flash drive has free
+//  space for one more copy of its largest video.
+//
+//  v 0.1  19 Oct 2026  Initial version.
+//  v 0.2  19 Oct 2026  Build with 64-bit file offsets so videos over 2 GB can be opened.  Flush the directory
+//                      after the rename.
+//  v 0.3  19 Oct 2026  A moov box with size 0 ("to the end of the file") gets its real size when moved.
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include "../PlayVideo/ListManager.h"
+#include "../PlayVideo/Mp4Probe.h"
+#include "../PlayVideo/FileIO.cpp"
+
+using namespace std;
+
+// Environment variable that locates the list file
+const char LIST_FILE_ENV_VAR[] = "DVDLISTFILE";
+
+// Largest moov box we are willing to hold in memory
+const long long MAX_MOOV_SIZE = 32LL*1024*1024;
+// Bytes per copy_file_range call
+const size_t COPY_CHUNK = 8*1024*1024;
+// The benchmark reads this much at the start of the file and at the start of the movie data,
+// about what a player reads before the first frame.
+const size_t BENCH_READ_SIZE = 64*1024;
+// Name prefix of the temporary file
+const char TEMP_PREFIX[] = ".faststart.";
+
+static bool look_only = false;
+static bool benchmark = false;
+static pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct drivework {
+   string drive;
+   string paths[MAXVIDEOFILES];
+   int count;
+   int rewritten, ok_already, skipped, failed;
+} drivework_t;
+
+static void put32(unsigned char *p, uint32_t v) {
+   p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void put64(unsigned char *p, uint64_t v) {
+   put32(p, v >> 32);
+   put32(p+4, (uint32_t)v);
+}
+
+static void report(string path, string message) {
+   pthread_mutex_lock(&print_lock);
+   cout << "FS: " << path << ": " << message << endl;
+   pthread_mutex_unlock(&print_lock);
+}
+
+// Add shift to every chunk offset in [low,high) in the stco and co64 boxes inside buf.
+// Returns false if the boxes are damaged or a 32-bit offset would overflow.
+static bool patchOffsets(unsigned char *buf, long long len, long long low, long long high, long long shift, int depth) {
+   if (depth > MAXBOXDEPTH) return false;
+   long long offset = 0;
+   while (offset + 8 <= len) {
+      unsigned char *p = buf + offset;
+      long long size = FileIO::be32(p);
+      int header_size = 8;
+      if (size == 1) {
+         if (offset + 16 > len) return false;
+         size = FileIO::be64(p+8);
+         header_size = 16;
+      }
+      else if (size == 0) {
+         size = len - offset;
+      }
+      if ((size < header_size) || (offset + size > len)) return false;
+      unsigned char *body = p + header_size;
+      long long body_size = size - header_size;
+
+      if ((memcmp(p+4, "moov", 4) == 0) || (memcmp(p+4, "trak", 4) == 0) || (memcmp(p+4, "mdia", 4) == 0) ||
+          (memcmp(p+4, "minf", 4) == 0) || (memcmp(p+4, "stbl", 4) == 0)) {
+         if (!patchOffsets(body, body_size, low, high, shift, depth+1)) return false;
+      }
+      else if ((memcmp(p+4, "stco", 4) == 0) || (memcmp(p+4, "co64", 4) == 0)) {
+         int width = (memcmp(p+4, "stco", 4) == 0) ? 4 : 8;
+         if (body_size < 8) return false;
+         long long count = FileIO::be32(body+4);
+         if (8 + count*width > body_size) return false;
+         for (long long i=0; i<count; i++) {
+            unsigned char *e = body + 8 + i*width;
+            uint64_t v = (width == 4) ? FileIO::be32(e) : FileIO::be64(e);
+            if (((long long)v < low) || ((long long)v >= high)) continue;
+            v += shift;
+            if (width == 4) {
+               if (v > 0xFFFFFFFFULL) return false;  // would need a co64 box
+               put32(e, (uint32_t)v);
+            }
+            else {
+               put64(e, v);
+            }
+         }
+      }
+      offset += size;
+   }
+   return true;
+}
+
+// Copy len bytes starting at in_offset to the current end of out_fd.  The data stays in the kernel.
+static bool copyRange(int in_fd, int out_fd, long long in_offset, long long len) {
+   if (lseek64(in_fd, in_offset, SEEK_SET) < 0) return false;
+   while (len > 0) {
+      ssize_t n = FileIO::copyChunk(in_fd, out_fd, len < (long long)COPY_CHUNK ? len : COPY_CHUNK);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      len -= n;
+   }
+   return true;
+}
+
+// Milliseconds from open to having the first movie data, with nothing in the page cache.
+// These are the reads a player makes: the start of the file, moov (wherever it is), then the
+// start of mdat.  Returns a negative value on error.
+static double timeToFirstByte(string path, mp4info_t *info) {
+   int fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+   if (fd < 0) return -1;
+   fdatasync(fd);
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+   close(fd);
+
+   char *buf = (char *)malloc(BENCH_READ_SIZE > (size_t)info->moov_size ? BENCH_READ_SIZE : info->moov_size);
+   if (buf == NULL) return -1;
+   double t0 = FileIO::secondsNow();
+   bool ok = false;
+   fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+   if (fd >= 0) {
+      ok = pread64(fd, buf, BENCH_READ_SIZE, 0) > 0;
+      if (ok && (info->moov_offset + info->moov_size > (long long)BENCH_READ_SIZE)) {
+         ok = FileIO::readAt(fd, buf, info->moov_size, info->moov_offset);
+      }
+      if (ok) ok = pread64(fd, buf, BENCH_READ_SIZE, info->mdat_offset) > 0;
+      close(fd);
+   }
+   double ms = (FileIO::secondsNow() - t0)*1000;
+   free(buf);
+   return ok ? ms : -1;
+}
+
+// Rewrite one file with moov in front.  Returns true if the file was rewritten.
+static bool fastStart(string path, mp4info_t *info, Mp4Probe &probe, string *why) {
+   // Layout must be ftyp first, then the rest.  Boxes between ftyp and moov move back by the
+   // size of moov, boxes after moov stay where they are.
+   if ((probe.topBoxCount() < 1) || (strcmp(probe.topBox(0).type, "ftyp") != 0)) {
+      *why = "ftyp is not the first box";
+      return false;
+   }
+   long long ftyp_end = probe.topBox(0).size;
+   long long moov_offset = info->moov_offset;
+   long long moov_size = info->moov_size;
+   if (moov_size > MAX_MOOV_SIZE) {
+      *why = "moov is too large";
+      return false;
+   }
+
+   struct stat st;
+   struct statvfs vfs;
+   if ((stat(path.c_str(), &st) != 0) || (statvfs(path.c_str(), &vfs) != 0)) {
+      *why = "cannot stat";
+      return false;
+   }
+   if ((long long)(vfs.f_bavail * vfs.f_frsize) < (long long)st.st_size) {
+      *why = "not enough free space on the drive for the new copy";
+      return false;
+   }
+
+   int in_fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+   if (in_fd < 0) {
+      *why = "cannot open";
+      return false;
+   }
+   unsigned char *moov = (unsigned char *)malloc(moov_size);
+   if ((moov == NULL) || !FileIO::readAt(in_fd, moov, moov_size, moov_offset)) {
+      free(moov);
+      close(in_fd);
+      *why = "cannot read moov";
+      return false;
+   }
+   if (!patchOffsets(moov, moov_size, ftyp_end, moov_offset, moov_size, 0)) {
+      free(moov);
+      close(in_fd);
+      *why = "chunk offsets cannot be moved (damaged moov, or a 32-bit stco would overflow)";
+      return false;
+   }
+   // A moov that was the last box may have size 0 ("to the end of the file").  In front of mdat
+   // it must carry its real size.  moov_size is below MAX_MOOV_SIZE so it fits in 32 bits.
+   if (FileIO::be32(moov) == 0) put32(moov, (uint32_t)moov_size);
+
+   size_t slash = path.find_last_of('/');
+   string temp = path.substr(0, slash+1) + TEMP_PREFIX + path.substr(slash+1);
+   unlink(temp.c_str());  // left over from an earlier run
+   int out_fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_LARGEFILE, 0644);
+   if (out_fd < 0) {
+      free(moov);
+      close(in_fd);
+      *why = "cannot create " + temp;
+      return false;
+   }
+
+   bool ok = copyRange(in_fd, out_fd, 0, ftyp_end);
+   ok = ok && FileIO::writeAll(out_fd, moov, moov_size);
+   ok = ok && copyRange(in_fd, out_fd, ftyp_end, moov_offset - ftyp_end);
+   ok = ok && copyRange(in_fd, out_fd, moov_offset + moov_size, st.st_size - (moov_offset + moov_size));
+   ok = ok && (fsync(out_fd) == 0);
+   free(moov);
+   close(out_fd);
+   close(in_fd);
+   if (!ok) {
+      unlink(temp.c_str());
+      *why = "writing the new file failed";
+      return false;
+   }
+
+   // The new file must probe as a complete MP4 with moov in front and the same duration
+   mp4info_t after;
+   Mp4Probe check;
+   if (!check.probe(temp, &after) || !after.complete || after.damaged || after.moov_at_end || (after.duration != info->duration)) {
+      unlink(temp.c_str());
+      *why = "the new file did not check out";
+      return false;
+   }
+   if (rename(temp.c_str(), path.c_str()) != 0) {
+      unlink(temp.c_str());
+      *why = "cannot rename the new file over the old one";
+      return false;
+   }
+   if (!FileIO::syncDirectory(path)) report(path, "warning: could not flush the directory after the rename");
+   *info = after;
+   return true;
+}
+
+static void *driveThread(void *arg) {
+   drivework_t *work = (drivework_t *)arg;
+   Mp4Probe probe;
+   for (int i=0; i<work->count; i++) {
+      string path = work->paths[i];
+      mp4info_t info;
+      if (!probe.probe(path, &info)) {
+         report(path, "cannot open");
+         work->failed++;
+         continue;
+      }
+      if (!info.is_mp4) {
+         report(path, "not an MP4 file, skipped");
+         work->skipped++;
+         continue;
+      }
+      if (info.damaged) {
+         report(path, "damaged MP4 file, skipped");
+         work->skipped++;
+         continue;
+      }
+      if (!info.complete) {
+         report(path, "too many boxes to check, skipped");
+         work->skipped++;
+         continue;
+      }
+      if (!info.moov_at_end) {
+         report(path, "moov already at the start");
+         work->ok_already++;
+         continue;
+      }
+      if (look_only) {
+         report(path, "moov at the end");
+         work->skipped++;
+         continue;
+      }
+
+      double before_ms = benchmark ? timeToFirstByte(path, &info) : 0;
+      double t0 = FileIO::secondsNow();
+      string why;
+      if (!fastStart(path, &info, probe, &why)) {
+         report(path, "FAILED: " + why);
+         work->failed++;
+         continue;
+      }
+      work->rewritten++;
+      char text[160];
+      snprintf(text, sizeof(text), "rewritten in %.1f s", FileIO::secondsNow() - t0);
+      string message = text;
+      if (benchmark) {
+         double after_ms = timeToFirstByte(path, &info);
+         snprintf(text, sizeof(text), ", time to first byte %.1f ms before, %.1f ms after", before_ms, after_ms);
+         message += text;
+      }
+      report(path, message);
+   }
+   return NULL;
+}
+
+int main(int argc, char *argv[])  {
+   string list_file_name;
+   for (int i=1; i<argc; i++) {
+      if (strcmp(argv[i], "-n") == 0) look_only = true;
+      else if (strcmp(argv[i], "-b") == 0) benchmark = true;
+      else list_file_name = argv[i];
+   }
+   if (list_file_name.empty()) {
+      char *env = getenv(LIST_FILE_ENV_VAR);
+      if (env == NULL) {
+         cout << "Usage: FastStart [-n] [-b] [list file]   (or set " << LIST_FILE_ENV_VAR << ")" << endl;
+         exit(-1);
+      }
+      list_file_name = env;
+   }
+
+   ListManager LM;
+   LM.initialize(list_file_name);
+
+   // Sort the videos by flash drive.  A file listed twice is done once.
+   static drivework_t work[MAXFLASHDRIVES];
+   string drives[MAXFLASHDRIVES];
+   int drive_count = 0;
+   for (int i=0; i<LM.videoCount(); i++) {
+      string path = LM.videoFilePath(i);
+      if (path.empty()) continue;
+      int first_new = drive_count;
+      int d = FileIO::driveIndex(path, drives, &drive_count, MAXFLASHDRIVES);
+      if (d < 0) continue;
+      if (d == first_new) {
+         work[d].drive = drives[d];
+         work[d].count = 0;
+         work[d].rewritten = work[d].ok_already = work[d].skipped = work[d].failed = 0;
+      }
+      bool listed = false;
+      for (int k=0; k<work[d].count; k++) {
+         if (work[d].paths[k] == path) listed = true;
+      }
+      if (!listed) work[d].paths[work[d].count++] = path;
+   }
+
+   pthread_t threads[MAXFLASHDRIVES];
+   bool started[MAXFLASHDRIVES];
+   for (int d=0; d<drive_count; d++) {
+      started[d] = (pthread_create(&threads[d], NULL, &driveThread, &work[d]) == 0);
+      if (!started[d]) cout << "FS: Cannot start a thread for " << work[d].drive << endl;
+   }
+   int rewritten = 0, ok_already = 0, skipped = 0, failed = 0;
+   for (int d=0; d<drive_count; d++) {
+      if (started[d]) pthread_join(threads[d], NULL);
+      rewritten += work[d].rewritten;
+      ok_already += work[d].ok_already;
+      skipped += work[d].skipped;
+      failed += work[d].failed;
+   }
+   cout << "FS: " << rewritten << " rewritten, " << ok_already << " already fast start, "
+        << skipped << " skipped, " << failed << " failed" << endl;
+   return failed ? 1 : 0;
+} // end main
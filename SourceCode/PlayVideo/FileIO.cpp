@@ -0,0 +1,158 @@
+// FileIO.cpp   Low level file helpers for background disk work, and small helpers shared by the
+//              classes that do it
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <string>
+
+using namespace std;
+
+#ifndef _FILE_IO_OBJECT
+#define _FILE_IO_OBJECT
+
+// Most flash drives (VIDEOS, VIDEOS1 ... VIDEOS9).  Background work keeps per drive state.
+const int MAXFLASHDRIVES = 10;
+
+// ioprio_set() has no glibc wrapper.  These values come from linux/ioprio.h
+const int IOPRIO_WHO_PROCESS   = 1;
+const int IOPRIO_CLASS_IDLE    = 3;
+const int IOPRIO_CLASS_SHIFT   = 13;
+
+class FileIO {
+   public:
+      // Put the calling thread in the idle I/O class.  The disk scheduler then only serves
+      // this thread when nobody else (the video player) wants the disk.
+      static bool setIdlePriority() {
+#ifdef SYS_ioprio_set
+         return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0;
+#else
+         return false;
+#endif
+      } // end setIdlePriority
+
+      // Copy up to len bytes from the current position of in_fd to the current position of out_fd
+      // without passing the data through user space.  copy_file_range() is tried first.  Older
+      // kernels, and copies between different file systems (FAT32 flash drive to the SD card),
+      // fall back to sendfile().  Returns the number of bytes copied, 0 at end of file, -1 on error.
+      static ssize_t copyChunk(int in_fd, int out_fd, size_t len) {
+         ssize_t n = -1;
+#ifdef SYS_copy_file_range
+         static volatile int use_copy_file_range = 1;
+         if (use_copy_file_range) {
+            n = syscall(SYS_copy_file_range, in_fd, NULL, out_fd, NULL, len, 0);
+            if (n >= 0) return n;
+            if ((errno != ENOSYS) && (errno != EXDEV) && (errno != EINVAL) && (errno != EOPNOTSUPP)) return -1;
+            use_copy_file_range = 0;  // not supported here.  Do not ask again.
+         }
+#endif
+         n = sendfile(out_fd, in_fd, NULL, len);
+         return n;
+      } // end copyChunk
+
+      // Read exactly len bytes at offset.  Returns false on a short read or an error.
+      static bool readAt(int fd, void *buf, size_t len, off64_t offset) {
+         char *p = (char *)buf;
+         while (len > 0) {
+            ssize_t n = pread64(fd, p, len, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n; len -= n; offset += n;
+         }
+         return true;
+      } // end readAt
+
+      // Write all len bytes at the current position of fd.  Returns false on an error.
+      static bool writeAll(int fd, const void *buf, size_t len) {
+         const char *p = (const char *)buf;
+         while (len > 0) {
+            ssize_t n = write(fd, p, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n; len -= n;
+         }
+         return true;
+      } // end writeAll
+
+      // Flush the directory holding path, so a rename() into it survives a power cut.
+      static bool syncDirectory(string path) {
+         size_t slash = path.find_last_of('/');
+         string dir = (slash == string::npos) ? "." : path.substr(0, slash+1);
+         int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+         if (fd < 0) return false;
+         bool ok = (fsync(fd) == 0);
+         close(fd);
+         return ok;
+      } // end syncDirectory
+
+      // Replace the file at path with text.  The text goes to path.tmp first and is renamed over
+      // path only if every write and the fsync worked, so a full SD card or a power cut leaves the
+      // old file in place.  Returns false, with the old file untouched, if anything failed.
+      static bool writeFileAtomically(string path, string text) {
+         string tmp = path + ".tmp";
+         FILE *f = fopen(tmp.c_str(), "w");
+         if (f == NULL) return false;
+         bool ok = (fwrite(text.data(), 1, text.length(), f) == text.length());
+         ok = (fflush(f) == 0) && ok;
+         ok = ok && (fsync(fileno(f)) == 0);
+         ok = (fclose(f) == 0) && ok;
+         if (!ok || (rename(tmp.c_str(), path.c_str()) != 0)) {
+            unlink(tmp.c_str());
+            return false;
+         }
+         syncDirectory(path);
+         return true;
+      } // end writeFileAtomically
+
+      // Split a tab separated line from one of our state files into count fields.  The last field
+      // is the rest of the line, so it may be a path with tabs in it.  Returns false if the line
+      // has too few fields (damaged, or written by an older version).
+      static bool splitFields(string line, string field[], int count) {
+         size_t start = 0;
+         for (int n=0; n<count-1; n++) {
+            size_t tab = line.find('\t', start);
+            if (tab == string::npos) return false;
+            field[n] = line.substr(start, tab-start);
+            start = tab+1;
+         }
+         field[count-1] = line.substr(start);
+         return true;
+      } // end splitFields
+
+      // Index in drives[] of the flash drive (directory, with slash at the end) that holds path.
+      // A new drive is added to drives[].  Returns -1 if drives[] is full.
+      static int driveIndex(string path, string drives[], int *drive_count, int max_drives) {
+         string drive = path.substr(0, path.find_last_of('/')+1);
+         for (int d=0; d<*drive_count; d++) {
+            if (drives[d] == drive) return d;
+         }
+         if (*drive_count == max_drives) return -1;
+         drives[*drive_count] = drive;
+         return (*drive_count)++;
+      } // end driveIndex
+
+      // MP4 numbers are big endian
+      static uint32_t be32(const unsigned char *p) {
+         return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+      }
+
+      static uint64_t be64(const unsigned char *p) {
+         return ((uint64_t)be32(p) << 32) | be32(p+4);
+      }
+
+      // Monotonic clock in seconds, for timing reads
+      static double secondsNow() {
+         struct timespec t;
+         clock_gettime(CLOCK_MONOTONIC, &t);
+         return t.tv_sec + t.tv_nsec/1e9;
+      }
+}; // FileIO
+
+
+#endif
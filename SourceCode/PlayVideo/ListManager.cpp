@@ -12,6 +12,9 @@ void ListManager::initialize(string input_list_filename) {
    string line;
 
    current_file_pointer=0;
+   videos = new videospec_t[MAXVIDEOFILES];
+   video_status = new int[MAXVIDEOFILES*VIDEO_CHECKERS];
+   for (int i=0; i<MAXVIDEOFILES*VIDEO_CHECKERS; i++) video_status[i]=VIDEO_UNCHECKED;
    ifstream listfile;
    for (int i=0; i<6; i++) {  // try 6 times to open the list file
       cout << "LM: Opening list file at:" << list_filename << endl;
@@ -107,20 +110,39 @@ void ListManager::initialize(string input_list_filename) {
 
 } // initialize()
 
+// Use the list already read by another ListManager.  Each ListManager keeps its own place
+// in the list, but the videos and their health flags are stored only once.
+void ListManager::shareList(ListManager &library) {
+   list_filename = library.list_filename;
+   videos = library.videos;
+   video_status = library.video_status;
+   last_file_pointer = library.last_file_pointer;
+   current_file_pointer = 0;
+}
+
 videospec_t ListManager::currentVideo() {
    return (videos[current_file_pointer]);
 }
 
+// Damaged videos are skipped so the user does not land on a frozen or black screen.
 videospec_t ListManager::nextVideo() {
-   current_file_pointer++;
-   if (current_file_pointer>=last_file_pointer) current_file_pointer=0;
+   for (int tries=0; tries<=last_file_pointer; tries++) {
+      current_file_pointer++;
+      if (current_file_pointer>=last_file_pointer) current_file_pointer=0;
+      if (videoStatus(current_file_pointer) != VIDEO_CORRUPT) break;
+      cout << "LM: skipping damaged video " << videos[current_file_pointer].dvd_filename << endl;
+   }
    cout << "LM: pointer=" << current_file_pointer << " video=" << videos[current_file_pointer].dvd_filename << endl;
    return (videos[current_file_pointer]);
 }  // nextVideo()
 
 videospec_t ListManager::previousVideo() {
-   current_file_pointer--;
-   if (current_file_pointer < 0) current_file_pointer=last_file_pointer;
+   for (int tries=0; tries<=last_file_pointer; tries++) {
+      current_file_pointer--;
+      if (current_file_pointer < 0) current_file_pointer=last_file_pointer;
+      if (videoStatus(current_file_pointer) != VIDEO_CORRUPT) break;
+      cout << "LM: skipping damaged video " << videos[current_file_pointer].dvd_filename << endl;
+   }
    cout << "LM: pointer=" << current_file_pointer << " video=" << videos[current_file_pointer].dvd_filename << endl;
    return (videos[current_file_pointer]);
 } // previousVideo()
@@ -129,6 +151,33 @@ int ListManager::videoCount() {
    return last_file_pointer+1;
 }
 
+// Full path of a video file on its flash drive, without the loop mark
+string ListManager::videoFilePath(int index) {
+   if ((index < 0) || (index > last_file_pointer)) return "";
+   string fn = videos[index].dvd_filename;
+   if ((fn.length() > 2) && (fn.at(0) == LOOP_VIDEO_MARK)) fn = fn.substr(1);
+   return videos[index].flash_drive_path + fn;
+}
+
+// Set one checker's report for every list entry that refers to this file.  A new report from
+// a checker replaces its old one, so a file that reads cleanly again is no longer skipped.
+void ListManager::flagVideo(string path, int checker, int status) {
+   if ((checker < 0) || (checker >= VIDEO_CHECKERS)) return;
+   for (int i=0; i<=last_file_pointer; i++) {
+      if (videoFilePath(i) == path) video_status[i*VIDEO_CHECKERS + checker] = status;
+   }
+}
+
+// Health of a list entry: the worst of the checkers' reports
+int ListManager::videoStatus(int index) {
+   if ((index < 0) || (index > last_file_pointer)) return VIDEO_UNCHECKED;
+   int status = VIDEO_UNCHECKED;
+   for (int c=0; c<VIDEO_CHECKERS; c++) {
+      if (video_status[index*VIDEO_CHECKERS + c] > status) status = video_status[index*VIDEO_CHECKERS + c];
+   }
+   return status;
+}
+
 void ListManager::resetVideoPointer() {
    last_file_pointer=current_file_pointer-1;
    current_file_pointer=0;
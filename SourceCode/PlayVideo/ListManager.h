@@ -24,6 +24,10 @@ typedef struct videospec {
 
 // Pre-allocated space for video files names. 
 static const int MAXVIDEOFILES = 300;
+// Most list files one PlayVideo serves (one per zone in multi-zone mode), and the most video files
+// the background services (VideoCache, VideoVerifier, MediaIndex) keep track of across them.
+static const int MAXLISTFILES = 8;
+static const int MAXLIBRARYFILES = MAXVIDEOFILES*MAXLISTFILES;
 
 #endif
 
@@ -36,23 +40,40 @@ const char EXTRA_VIDEO_DISK_MARK = '@';
 const char LOOP_VIDEO_MARK = '@';   
 const string whitespace = " \t";
 
+// Health of a video file, as reported by VideoVerifier and MediaIndex.  Worse is higher.
+const int VIDEO_UNCHECKED = 0;
+const int VIDEO_OK        = 1;
+const int VIDEO_CHANGED   = 2;   // file was replaced since the last check. It reads fine.
+const int VIDEO_CORRUPT   = 3;   // read errors, broken MP4 boxes, or contents changed without the file being replaced
+
+// Who reported the health.  Each checker keeps its own report so one can clear what it reported
+// earlier without hiding what the other found.
+const int CHECKER_VERIFIER = 0;
+const int CHECKER_INDEX    = 1;
+const int VIDEO_CHECKERS   = 2;
+
 
 class ListManager {
 
    private:
       string list_filename;  // full path and name of list file
-      videospec_t videos[MAXVIDEOFILES];  // Pre-allocate space
+      videospec_t *videos;  // Pre-allocated by initialize(), or shared with another ListManager
       int last_file_pointer;
       int current_file_pointer;
+      volatile int *video_status;  // VIDEO_CHECKERS reports per video, set by the checker threads.  Shared along with videos.
       string remove_char( string str, char ch);
       string trim (const string str);
 
    public:
       void initialize(string input_list_filename);
+      void shareList(ListManager &library);
       videospec_t currentVideo();
       videospec_t nextVideo();
       videospec_t previousVideo();
       int videoCount();
+      string videoFilePath(int index);
+      void flagVideo(string path, int checker, int status);
+      int videoStatus(int index);
       void resetVideoPointer();
 
 }; // ListManager
@@ -0,0 +1,227 @@
+// MediaIndex.cpp
+
+#include <time.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "MediaIndex.h"
+
+typedef struct indexthreadarg {
+   MediaIndex *index;
+   int drive;
+} indexthreadarg_t;
+
+static const int INDEX_FIELDS = 14;
+
+// implementation of class MediaIndex
+//
+void MediaIndex::initialize(string index_file, ListManager *list_managers[], int list_managers_count) {
+   index_filename = index_file;
+   list_count = 0;
+   record_count = 0;
+   drive_count = 0;
+   drives_running = 0;
+   pthread_mutex_init(&lock, NULL);
+
+   // One record per video file, across all the list files.  A file listed twice is probed once.
+   for (int l=0; (l<list_managers_count) && (list_count<MAXLISTFILES); l++) {
+      ListManager *LM = list_managers[l];
+      lists[list_count++] = LM;
+      for (int i=0; (i<LM->videoCount()) && (record_count<MAXLIBRARYFILES); i++) {
+         string path = LM->videoFilePath(i);
+         if (path.empty() || (findRecord(path) >= 0)) continue;
+         int d = FileIO::driveIndex(path, drives, &drive_count, MAXFLASHDRIVES);
+         if (d < 0) continue;
+         records[record_count].path = path;
+         records[record_count].drive = d;
+         records[record_count].size = 0;
+         records[record_count].mtime = 0;
+         records[record_count].probed = false;
+         Mp4Probe::clearInfo(&records[record_count].info);
+         record_count++;
+      }
+   }
+   loadIndex();
+   cout << "MI: " << record_count << " video files on " << drive_count << " drives" << endl;
+} // initialize()
+
+// One probe thread per flash drive.  Each drive is a separate USB device, so they do not
+// slow each other down.  Probing a file is a few small reads, so one thread per drive is plenty.
+void MediaIndex::start() {
+   drives_running = drive_count;
+   for (int d=0; d<drive_count; d++) {
+      indexthreadarg_t *arg = new indexthreadarg_t;
+      arg->index = this;
+      arg->drive = d;
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, &MediaIndex::probeThread, arg) != 0) {
+         cout << "MI: Cannot start a probe thread for " << drives[d] << endl;
+         delete arg;
+         pthread_mutex_lock(&lock);
+         drives_running--;
+         pthread_mutex_unlock(&lock);
+         continue;
+      }
+      pthread_detach(thread);
+   }
+} // start()
+
+// Returns false if the file is not in the index or has not been probed yet
+bool MediaIndex::lookup(string path, mp4info_t *info) {
+   pthread_mutex_lock(&lock);
+   int i = findRecord(path);
+   bool found = (i >= 0) && records[i].probed;
+   if (found) *info = records[i].info;
+   pthread_mutex_unlock(&lock);
+   return found;
+}
+
+// One line summary for the log, e.g. "1:52:03  avc1/mp4a  4.2 Mb/s  moov at end".  Things the
+// probe could not find out (duration, or the boxes past the walk limit) are shown as unknown.
+string MediaIndex::describe(mp4info_t *info) {
+   if (!info->is_mp4) return "not an MP4 file";
+   if (info->damaged) return "DAMAGED MP4 file";
+   char text[160];
+   long seconds = (long)info->duration;
+   if (info->duration > 0) {
+      snprintf(text, sizeof(text), "%ld:%02ld:%02ld  %s/%s  %.1f Mb/s", seconds/3600, (seconds/60)%60, seconds%60,
+               info->video_codec[0] ? info->video_codec : "-", info->audio_codec[0] ? info->audio_codec : "-",
+               info->bitrate/1e6);
+   }
+   else {
+      snprintf(text, sizeof(text), "duration unknown  %s/%s",
+               info->video_codec[0] ? info->video_codec : "-", info->audio_codec[0] ? info->audio_codec : "-");
+   }
+   string description = text;
+   if (info->moov_offset >= 0) description += info->moov_at_end ? "  moov at end" : "  moov at start";
+   if (!info->complete) description += "  (not all boxes checked)";
+   return description;
+}
+
+int MediaIndex::findRecord(string path) {
+   for (int i=0; i<record_count; i++) {
+      if (records[i].path == path) return i;
+   }
+   return -1;
+}
+
+// Report to every list that has this file
+void MediaIndex::flagVideo(string path, int status) {
+   for (int l=0; l<list_count; l++) lists[l]->flagVideo(path, CHECKER_INDEX, status);
+}
+
+// Index file: one line per video, tab separated:
+//   size  mtime  is_mp4  damaged  complete  moov_at_end  moov_offset  moov_size  mdat_offset  duration  bitrate  video  audio  path
+void MediaIndex::loadIndex() {
+   ifstream indexfile(index_filename.c_str());
+   string line;
+   while (getline(indexfile, line)) {
+      string field[INDEX_FIELDS];
+      if (!FileIO::splitFields(line, field, INDEX_FIELDS)) continue;  // damaged line, or from an older version
+
+      int i = findRecord(field[INDEX_FIELDS-1]);
+      if (i < 0) continue;  // no longer in the list file
+      mp4info_t *info = &records[i].info;
+      int is_mp4, damaged, complete, moov_at_end;
+      sscanf(field[0].c_str(), "%lld", &records[i].size);
+      sscanf(field[1].c_str(), "%ld", &records[i].mtime);
+      sscanf(field[2].c_str(), "%d", &is_mp4);
+      sscanf(field[3].c_str(), "%d", &damaged);
+      sscanf(field[4].c_str(), "%d", &complete);
+      sscanf(field[5].c_str(), "%d", &moov_at_end);
+      sscanf(field[6].c_str(), "%lld", &info->moov_offset);
+      sscanf(field[7].c_str(), "%lld", &info->moov_size);
+      sscanf(field[8].c_str(), "%lld", &info->mdat_offset);
+      sscanf(field[9].c_str(), "%lf", &info->duration);
+      sscanf(field[10].c_str(), "%ld", &info->bitrate);
+      info->is_mp4 = is_mp4;
+      info->damaged = damaged;
+      info->complete = complete;
+      info->moov_at_end = moov_at_end;
+      strncpy(info->video_codec, field[11] == "-" ? "" : field[11].c_str(), 4);
+      strncpy(info->audio_codec, field[12] == "-" ? "" : field[12].c_str(), 4);
+      info->video_codec[4] = 0;
+      info->audio_codec[4] = 0;
+      records[i].probed = true;
+   }
+}
+
+// Contents of the index file.  Caller holds the lock.
+string MediaIndex::indexText() {
+   string text;
+   char line[256];
+   for (int i=0; i<record_count; i++) {
+      if (!records[i].probed) continue;
+      mp4info_t *info = &records[i].info;
+      snprintf(line, sizeof(line), "%lld\t%ld\t%d\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%.3f\t%ld\t%s\t%s\t",
+               records[i].size, records[i].mtime, info->is_mp4, info->damaged, info->complete, info->moov_at_end,
+               info->moov_offset, info->moov_size, info->mdat_offset, info->duration, info->bitrate,
+               info->video_codec[0] ? info->video_codec : "-", info->audio_codec[0] ? info->audio_codec : "-");
+      text += line + records[i].path + "\n";
+   }
+   return text;
+}
+
+void *MediaIndex::probeThread(void *arg) {
+   indexthreadarg_t *a = (indexthreadarg_t *)arg;
+   MediaIndex *index = a->index;
+   int drive = a->drive;
+   delete a;
+   index->probeDrive(drive);
+   return NULL;
+}
+
+void MediaIndex::probeDrive(int drive) {
+   Mp4Probe probe;
+   int probed = 0, cached = 0;
+   for (int i=0; i<record_count; i++) {
+      if (records[i].drive != drive) continue;
+      string path = records[i].path;
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0) continue;  // missing files are reported by PlayVideo
+
+      pthread_mutex_lock(&lock);
+      bool fresh = records[i].probed && (records[i].size == st.st_size) && (records[i].mtime == st.st_mtime);
+      mp4info_t info = records[i].info;
+      pthread_mutex_unlock(&lock);
+
+      if (!fresh) {
+         if (!probe.probe(path, &info)) continue;
+         probed++;
+         cout << "MI: " << path << ": " << describe(&info) << endl;
+         pthread_mutex_lock(&lock);
+         records[i].info = info;
+         records[i].size = st.st_size;
+         records[i].mtime = st.st_mtime;
+         records[i].probed = true;
+         pthread_mutex_unlock(&lock);
+      }
+      else {
+         cached++;
+      }
+      flagVideo(path, (info.is_mp4 && info.damaged) ? VIDEO_CORRUPT : VIDEO_OK);
+   }
+
+   // The last drive to finish saves the index and reports
+   pthread_mutex_lock(&lock);
+   cout << "MI: Done with " << drives[drive] << ": " << probed << " probed, " << cached << " unchanged" << endl;
+   drives_running--;
+   bool last = (drives_running == 0);
+   string text;
+   if (last) {
+      text = indexText();
+      int moov_at_end = 0, damaged = 0, unchecked = 0;
+      for (int i=0; i<record_count; i++) {
+         if (!records[i].probed) continue;
+         if (records[i].info.moov_at_end) moov_at_end++;
+         if (records[i].info.is_mp4 && records[i].info.damaged) damaged++;
+         else if (records[i].info.is_mp4 && !records[i].info.complete) unchecked++;
+      }
+      cout << "MI: Index complete. " << moov_at_end << " videos have moov at the end, " << damaged << " are damaged, "
+           << unchecked << " could not be fully checked" << endl;
+   }
+   pthread_mutex_unlock(&lock);
+   // Written outside the lock so lookup() from the player never waits for the SD card
+   if (last && !FileIO::writeFileAtomically(index_filename, text)) {
+      cout << "MI: Cannot save the index in " << index_filename << endl;
+   }
+}
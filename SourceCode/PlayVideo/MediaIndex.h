@@ -0,0 +1,62 @@
+// MediaIndex.h
+//
+//  The MediaIndex class probes every video in the list with Mp4Probe, one thread per flash drive,
+//  and keeps what it learns (duration, codecs, bit rate, moov location, damage) for each list entry.
+//  Results are cached in a file and reused while a video's size and modification time are unchanged.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <pthread.h>
+#include "ListManager.h"
+#include "Mp4Probe.h"
+#include "FileIO.cpp"
+
+using namespace std;
+
+#ifndef _MEDIAINDEX_H
+#define _MEDIAINDEX_H
+
+typedef struct indexrecord {
+   string path;            // full path of the video file
+   int drive;              // index into drives[]
+   long long size;         // size and modification time when probed
+   long mtime;
+   bool probed;            // info is good for this size and mtime
+   mp4info_t info;
+} indexrecord_t;
+
+
+class MediaIndex {
+
+   private:
+      string index_filename;
+      ListManager *lists[MAXLISTFILES];
+      int list_count;
+      indexrecord_t records[MAXLIBRARYFILES];
+      int record_count;
+      string drives[MAXFLASHDRIVES];
+      int drive_count;
+      int drives_running;
+      pthread_mutex_t lock;
+
+      int findRecord(string path);
+      void flagVideo(string path, int status);
+      void loadIndex();
+      string indexText();
+      static void *probeThread(void *arg);
+      void probeDrive(int drive);
+
+   public:
+      void initialize(string index_file, ListManager *list_managers[], int list_managers_count);
+      void start();
+      bool lookup(string path, mp4info_t *info);
+      static string describe(mp4info_t *info);
+
+}; // MediaIndex
+
+
+#endif
@@ -0,0 +1,176 @@
+// Mp4Probe.cpp
+
+#include <fcntl.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "Mp4Probe.h"
+#include "FileIO.cpp"
+
+// Results of walking boxes
+static const int WALK_DONE      = 0;   // every box fits
+static const int WALK_TRUNCATED = 1;   // a box runs past the end of the file or its parent
+static const int WALK_STOPPED   = 2;   // too many boxes, nested too deep, or a read failed
+
+// implementation of class Mp4Probe
+//
+// Returns true if the file could be opened.  The findings are in info.
+bool Mp4Probe::probe(string path, mp4info_t *info) {
+   clearInfo(info);
+   top_count = 0;
+   box_count = 0;
+   handler[0] = 0;
+
+   fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+   if (fd < 0) return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+   }
+   file_size = st.st_size;
+   posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);  // no read-ahead, we only want the headers
+
+   int walked = walk(0, file_size, 0, info);
+   close(fd);
+
+   bool have_ftyp = false, have_mdat = false, have_moov = false;
+   for (int i=0; i<top_count; i++) {
+      if (strcmp(top[i].type, "ftyp") == 0) have_ftyp = true;
+      if ((strcmp(top[i].type, "mdat") == 0) && !have_mdat) {
+         have_mdat = true;
+         info->mdat_offset = top[i].offset;
+      }
+      if ((strcmp(top[i].type, "moov") == 0) && !have_moov) {
+         have_moov = true;
+         info->moov_offset = top[i].offset;
+         info->moov_size = top[i].size;
+      }
+   }
+   info->is_mp4 = (top_count > 0) && have_ftyp;
+   info->complete = (walked == WALK_DONE);
+   // A missing moov or mdat only counts if the whole file was walked
+   info->damaged = (walked == WALK_TRUNCATED) || (info->complete && !(have_moov && have_mdat));
+   info->moov_at_end = have_moov && have_mdat && (info->moov_offset > info->mdat_offset);
+   if (info->duration > 0) info->bitrate = (long)(file_size*8/info->duration);
+   return true;
+} // probe()
+
+int Mp4Probe::topBoxCount() {
+   return top_count;
+}
+
+mp4box_t Mp4Probe::topBox(int index) {
+   return top[index];
+}
+
+void Mp4Probe::clearInfo(mp4info_t *info) {
+   info->is_mp4 = false;
+   info->damaged = false;
+   info->complete = false;
+   info->moov_at_end = false;
+   info->moov_offset = -1;
+   info->moov_size = 0;
+   info->mdat_offset = -1;
+   info->duration = 0;
+   info->bitrate = 0;
+   info->video_codec[0] = 0;
+   info->audio_codec[0] = 0;
+}
+
+// Read the box header at offset.  Returns WALK_TRUNCATED if the box claims to run past end.
+int Mp4Probe::readBox(long long offset, long long end, mp4box_t *box) {
+   unsigned char h[16];
+   if (!FileIO::readAt(fd, h, 8, offset)) return WALK_STOPPED;
+   long long size = FileIO::be32(h);
+   memcpy(box->type, h+4, 4);
+   box->type[4] = 0;
+   box->offset = offset;
+   box->header_size = 8;
+   if (size == 1) {  // 64-bit size follows the type
+      if (end - offset < 16) return WALK_TRUNCATED;
+      if (!FileIO::readAt(fd, h+8, 8, offset+8)) return WALK_STOPPED;
+      size = FileIO::be64(h+8);
+      box->header_size = 16;
+   }
+   else if (size == 0) {  // box runs to the end of the file
+      size = end - offset;
+   }
+   box->size = size;
+   if ((size < box->header_size) || (offset + size > end)) return WALK_TRUNCATED;
+   return WALK_DONE;
+}
+
+// Walk the boxes between start and end.  Only the containers on the way to the boxes we want
+// are entered.  Fewer than 8 bytes left over is padding some muxers add, not a box.
+int Mp4Probe::walk(long long start, long long end, int depth, mp4info_t *info) {
+   if (depth > MAXBOXDEPTH) return WALK_STOPPED;
+   long long offset = start;
+   while (end - offset >= 8) {
+      mp4box_t box;
+      int result = readBox(offset, end, &box);
+      if (result != WALK_DONE) return result;
+      if (++box_count > MAXBOXCOUNT) return WALK_STOPPED;
+      if ((depth == 0) && (top_count < MAXTOPBOXES)) top[top_count++] = box;
+
+      long long body = box.offset + box.header_size;
+      long long box_end = box.offset + box.size;
+      if (strcmp(box.type, "mvhd") == 0) readMvhd(&box, info);
+      else if (strcmp(box.type, "hdlr") == 0) readHdlr(&box);
+      else if (strcmp(box.type, "stsd") == 0) readStsd(&box, info);
+      else if (strcmp(box.type, "trak") == 0) {
+         handler[0] = 0;
+         result = walk(body, box_end, depth+1, info);
+      }
+      else if ((strcmp(box.type, "moov") == 0) || (strcmp(box.type, "mdia") == 0) ||
+               (strcmp(box.type, "minf") == 0) || (strcmp(box.type, "stbl") == 0)) {
+         result = walk(body, box_end, depth+1, info);
+      }
+      if (result != WALK_DONE) return result;
+      offset = box_end;
+   }
+   return WALK_DONE;
+}
+
+// Movie header: time scale and duration of the whole movie
+void Mp4Probe::readMvhd(mp4box_t *box, mp4info_t *info) {
+   unsigned char b[32];
+   long long body = box->offset + box->header_size;
+   if ((box->size - box->header_size < 20) || !FileIO::readAt(fd, b, 1, body)) return;
+   uint32_t timescale;
+   uint64_t duration;
+   if (b[0] == 1) {  // version 1: 64-bit times
+      if ((box->size - box->header_size < 32) || !FileIO::readAt(fd, b, 32, body)) return;
+      timescale = FileIO::be32(b+20);
+      duration = FileIO::be64(b+24);
+   }
+   else {
+      if (!FileIO::readAt(fd, b, 20, body)) return;
+      timescale = FileIO::be32(b+12);
+      duration = FileIO::be32(b+16);
+   }
+   if (timescale > 0) info->duration = (double)duration / timescale;
+}
+
+// Handler: tells whether the track being walked is video or sound
+void Mp4Probe::readHdlr(mp4box_t *box) {
+   unsigned char b[12];
+   long long body = box->offset + box->header_size;
+   if ((box->size - box->header_size < 12) || !FileIO::readAt(fd, b, 12, body)) return;
+   memcpy(handler, b+8, 4);
+   handler[4] = 0;
+}
+
+// Sample description: the type of the first entry is the codec
+void Mp4Probe::readStsd(mp4box_t *box, mp4info_t *info) {
+   unsigned char b[16];
+   long long body = box->offset + box->header_size;
+   if ((box->size - box->header_size < 16) || !FileIO::readAt(fd, b, 16, body)) return;
+   if (FileIO::be32(b+4) == 0) return;  // no entries
+   char *codec = NULL;
+   if (strcmp(handler, "vide") == 0) codec = info->video_codec;
+   if (strcmp(handler, "soun") == 0) codec = info->audio_codec;
+   if ((codec == NULL) || (codec[0] != 0)) return;  // not wanted, or already have the first track
+   memcpy(codec, b+12, 4);
+   codec[4] = 0;
+}
@@ -0,0 +1,71 @@
+// Mp4Probe.h
+//
+//  The Mp4Probe class looks inside an MP4 (ISO base media) file without decoding anything.  It reads
+//  only box headers and a few small boxes (mvhd, hdlr, stsd) with pread, and reports whether the file
+//  is complete, how long it is, its codecs and bit rate, and where the moov box sits.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+
+using namespace std;
+
+#ifndef _MP4PROBE_H
+#define _MP4PROBE_H
+
+// Most top level boxes remembered.  Real files have a handful (ftyp, free, mdat, moov).
+const int MAXTOPBOXES = 32;
+// Stop walking files with deep box nesting or very many boxes (long fragmented files).
+// What was found up to that point is kept, but the rest of the file is not checked.
+const int MAXBOXDEPTH = 8;
+const int MAXBOXCOUNT = 10000;
+
+typedef struct mp4box {
+   char type[5];           // four character code
+   long long offset;       // start of the box header in the file
+   long long size;         // whole box, header included
+   int header_size;        // 8, or 16 for boxes with a 64-bit size
+} mp4box_t;
+
+typedef struct mp4info {
+   bool is_mp4;            // starts with an ftyp box
+   bool damaged;           // a box runs past the end of the file (truncated), or moov or mdat is missing
+   bool complete;          // every box was walked.  False if a limit above was hit or a read failed.
+   bool moov_at_end;       // moov comes after mdat.  The player must seek to the end before the first frame.
+   long long moov_offset;
+   long long moov_size;
+   long long mdat_offset;  // first mdat
+   double duration;        // seconds.  0 if unknown (fragmented files often leave it 0).
+   long bitrate;           // bits per second over the whole file.  0 if the duration is unknown.
+   char video_codec[5];    // sample entry of the first video track, e.g. "avc1".  Empty if none.
+   char audio_codec[5];    // sample entry of the first audio track, e.g. "mp4a".  Empty if none.
+} mp4info_t;
+
+
+class Mp4Probe {
+
+   private:
+      int fd;
+      long long file_size;
+      int box_count;
+      mp4box_t top[MAXTOPBOXES];
+      int top_count;
+      char handler[5];       // handler type of the track being walked ("vide", "soun")
+
+      int readBox(long long offset, long long end, mp4box_t *box);
+      int walk(long long start, long long end, int depth, mp4info_t *info);
+      void readMvhd(mp4box_t *box, mp4info_t *info);
+      void readHdlr(mp4box_t *box);
+      void readStsd(mp4box_t *box, mp4info_t *info);
+
+   public:
+      bool probe(string path, mp4info_t *info);
+      int topBoxCount();
+      mp4box_t topBox(int index);
+      static void clearInfo(mp4info_t *info);
+
+}; // Mp4Probe
+
+
+#endif
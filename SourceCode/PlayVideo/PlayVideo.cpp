@@ -11,6 +11,31 @@ void PlayVideo::initialize(string player_filename, string player_options) {
    // extract the DVD library path from the input_list_filename (path and name of list file)
    PPPath = player_filename + " ";
    PPOptions = player_options;
+   cache = NULL;
+   media = NULL;
+   own_group = false;
+}
+
+// Report what is known about each video as it starts
+void PlayVideo::useMediaIndex(MediaIndex *media_index) {
+   media = media_index;
+}
+
+// Start each player in a process group of its own, with no keyboard, so playStop() can end
+// this player without touching the players of other zones.  A background process group must not
+// touch the terminal, so the player gets /dev/null as its input.
+// This process also becomes the reaper of the player's orphaned processes (the shell and the
+// player itself outlive our child for a moment), so playStopped() can see the group empty out.
+void PlayVideo::useProcessGroup() {
+   own_group = true;
+   prctl(PR_SET_CHILD_SUBREAPER, 1);
+}
+
+// Play local copies of the videos when the cache has them.  Players sharing a cache each have
+// their own number so the cache keeps every player's video.
+void PlayVideo::useCache(VideoCache *video_cache, int player) {
+   cache = video_cache;
+   cache_player = player;
 }
 
 // Returns true if start was successful
@@ -32,6 +57,16 @@ bool PlayVideo::playStart(videospec_t video) {
 
    string PPVolume = "--vol " + SSTR(video.volume+SYSTEM_VOLUME);
    string VFN = video.flash_drive_path+dvd_filename;
+   mp4info_t info;
+   if ((media != NULL) && media->lookup(VFN, &info)) {
+      cout << "PV: " << MediaIndex::describe(&info) << endl;
+   }
+   if (cache != NULL) {
+      cache->recordPlay(VFN, cache_player);
+      string local = cache->localPath(VFN);
+      if (local != VFN) cout << "PV: Using local copy of " << VFN << endl;
+      VFN = local;
+   }
    string playString = PPPath + PPVolume + " " + PPOptions + loopOption + " \"" + VFN + "\"";
    printf("PV: playString\n");
    cout << "PV: " << playString << endl;
@@ -53,6 +88,10 @@ bool PlayVideo::playStart(videospec_t video) {
       return false; // some hope of recovery, but not much.
    }
    if (child_process_PID == 0) { // CHILD
+      if (own_group) {
+         setpgid(0,0);
+         freopen("/dev/null", "r", stdin);
+      }
       printf("\nPV: CHILD process is starting the video player\n");
       MyChildPID = getpid();
       cout << "PID number is " << getpid() << endl;
@@ -62,6 +101,7 @@ bool PlayVideo::playStart(videospec_t video) {
       printf("\nPV: CHILD: Video player terminated\n");
       exit(0);
    } // CHILD
+   if (own_group) setpgid(child_process_PID, child_process_PID);  // in case the parent gets here first
    return true;  // PARENT
 } //playStart
 
@@ -80,3 +120,33 @@ void PlayVideo::playEnd(){
       cout << grepResult << endl;
       printf("PV: Done killing player. \n");
 } // playEnd
+
+// Ask this player (and only this player) to quit.  Does not wait.  Call playStopped() until it
+// returns true.  Used in multi-zone mode, where killall would stop every zone's player.
+// Requires useProcessGroup().
+void PlayVideo::playStop() {
+   stop_time = millis();
+   stop_forced = false;
+   if (child_process_PID > 0) {
+      printf("\nPV: Stopping player group %d\n", child_process_PID);
+      kill(-child_process_PID, SIGTERM);
+   }
+} // playStop
+
+// True when every process of the stopped player is gone.  A player that ignores SIGTERM for
+// KILL_WAIT_TIME gets SIGKILL.
+bool PlayVideo::playStopped() {
+   if (child_process_PID <= 0) return true;
+   // Reap every finished player process, ours or another zone's, so none linger as zombies
+   while (waitpid(-1, NULL, WNOHANG) > 0) ;
+   if ((kill(-child_process_PID, 0) != 0) && (errno == ESRCH)) {
+      child_process_PID = -1;
+      return true;
+   }
+   if (!stop_forced && (millis() - stop_time > (unsigned int)KILL_WAIT_TIME)) {
+      printf("\nPV: Player group %d did not stop.  Killing it.\n", child_process_PID);
+      kill(-child_process_PID, SIGKILL);
+      stop_forced = true;
+   }
+   return false;
+} // playStopped
@@ -11,7 +11,12 @@
 #include <sstream>
 #include<sys/types.h>
 #include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
 #include "ListManager.h"
+#include "VideoCache.h"
+#include "MediaIndex.h"
 #include "ExecuteCommand.cpp"
 
 using namespace std;
@@ -42,11 +47,22 @@ class PlayVideo {
       int MyChildPID;
       string PPPath;
       string PPOptions;
+      VideoCache *cache;
+      MediaIndex *media;
+      int cache_player;         // this player's number in the cache
+      unsigned int stop_time;   // millis() when playStop() was called
+      bool stop_forced;
+      bool own_group;           // player runs in its own process group (multi-zone mode)
 
    public:
       void initialize(string player_filename, string player_options);
+      void useCache(VideoCache *video_cache, int player);
+      void useMediaIndex(MediaIndex *media_index);
+      void useProcessGroup();
       bool playStart(videospec_t video);
       void playEnd();
+      void playStop();
+      bool playStopped();
 
 }; // PlayVideo
 
@@ -0,0 +1,378 @@
+// VideoCache.cpp
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include "VideoCache.h"
+#include "FileIO.cpp"
+
+// implementation of class VideoCache
+//
+void VideoCache::initialize(string cache_directory, long long budget_mb, ListManager *list_managers[], int list_managers_count) {
+   enabled = false;
+   cache_dir = cache_directory;
+   if (cache_dir.empty()) return;
+   if (cache_dir.at(cache_dir.length()-1) != '/') cache_dir += "/";
+   budget = budget_mb*1024*1024;
+   used = 0;
+   for (int p=0; p<MAXPLAYERS; p++) playing[p] = -1;
+
+   cout << "VC: Cache directory " << cache_dir << "  budget " << budget_mb << " MB" << endl;
+   mkdir(cache_dir.c_str(), 0755);
+   struct stat st;
+   if ((stat(cache_dir.c_str(), &st) != 0) || !S_ISDIR(st.st_mode)) {
+      cout << "VC: Cannot use the cache directory.  Cache is off." << endl;
+      return;
+   }
+
+   // One entry per video file, across all the list files.  A file listed twice shares one entry.
+   entry_count = 0;
+   for (int l=0; (l<list_managers_count) && (l<MAXLISTFILES); l++) {
+      ListManager *LM = list_managers[l];
+      for (int i=0; (i<LM->videoCount()) && (entry_count<MAXLIBRARYFILES); i++) {
+         string source = LM->videoFilePath(i);
+         if (source.empty() || (findEntry(source) >= 0)) continue;
+         entries[entry_count].source = source;
+         entries[entry_count].local_name = "";
+         entries[entry_count].size = 0;
+         entries[entry_count].mtime = 0;
+         entries[entry_count].plays = 0;
+         entries[entry_count].last_played = 0;
+         entries[entry_count].copy_failed = false;
+         entry_count++;
+      }
+   }
+
+   loadState();
+   removeOrphans();
+   for (int i=0; i<entry_count; i++) {
+      if (!entries[i].local_name.empty()) used += entries[i].size;
+   }
+   state_dirty = !saveState(stateText());
+   cout << "VC: " << used/(1024*1024) << " MB of local copies" << endl;
+
+   pthread_mutex_init(&lock, NULL);
+   pthread_cond_init(&wake, NULL);
+   if (pthread_create(&stager, NULL, &VideoCache::stagerThread, this) != 0) {
+      cout << "VC: Cannot start the copy thread.  Cache is off." << endl;
+      return;
+   }
+   enabled = true;
+} // initialize()
+
+// Count one more play of this video and let the copy thread decide if it should be copied.
+// This is on the path from button press to picture, so the state file is left to the copy thread.
+// player tells the zones apart, so each zone's video is kept while it plays.
+void VideoCache::recordPlay(string source, int player) {
+   if (!enabled) return;
+   pthread_mutex_lock(&lock);
+   int i = findEntry(source);
+   if ((player >= 0) && (player < MAXPLAYERS)) playing[player] = i;
+   if (i >= 0) {
+      entries[i].plays++;
+      entries[i].last_played = time(NULL);
+      entries[i].copy_failed = false;  // popularity changed, worth another try
+      state_dirty = true;
+      pthread_cond_signal(&wake);
+   }
+   pthread_mutex_unlock(&lock);
+} // recordPlay()
+
+// Returns the path of the local copy if there is a good one, otherwise the source path.
+string VideoCache::localPath(string source) {
+   if (!enabled) return source;
+   pthread_mutex_lock(&lock);
+   int i = findEntry(source);
+   if ((i < 0) || entries[i].local_name.empty()) {
+      pthread_mutex_unlock(&lock);
+      return source;
+   }
+   string local = cache_dir + entries[i].local_name;
+   long long size = entries[i].size;
+   long mtime = entries[i].mtime;
+   pthread_mutex_unlock(&lock);
+
+   struct stat st;
+   bool valid = (stat(local.c_str(), &st) == 0) && (st.st_size == size);
+   // If the flash drive is missing, the local copy is still good.  If the file on the flash
+   // drive was replaced, the local copy is stale.
+   if (valid && (stat(source.c_str(), &st) == 0)) {
+      valid = (st.st_size == size) && (st.st_mtime == mtime);
+   }
+   if (!valid) {
+      cout << "VC: Local copy of " << source << " is out of date.  Removing it." << endl;
+      pthread_mutex_lock(&lock);
+      dropLocal(i);
+      pthread_cond_signal(&wake);
+      pthread_mutex_unlock(&lock);
+      return source;
+   }
+   return local;
+} // localPath()
+
+int VideoCache::findEntry(string source) {
+   for (int i=0; i<entry_count; i++) {
+      if (entries[i].source == source) return i;
+   }
+   return -1;
+}
+
+// True if some player is playing this entry.  Caller holds the lock.
+bool VideoCache::isPlaying(int index) {
+   for (int p=0; p<MAXPLAYERS; p++) {
+      if (playing[p] == index) return true;
+   }
+   return false;
+}
+
+// True if video a is worth more local space than video b: played more often or, on a tie, more recently.
+bool VideoCache::moreValuable(int a, int b) {
+   if (entries[a].plays != entries[b].plays) return entries[a].plays > entries[b].plays;
+   return entries[a].last_played > entries[b].last_played;
+}
+
+// Local copies are named by a hash of the full source path (FNV-1a), keeping the extension.
+string VideoCache::localName(string source) {
+   unsigned long long h = 14695981039346656037ULL;
+   for (size_t i=0; i<source.length(); i++) {
+      h ^= (unsigned char)source[i];
+      h *= 1099511628211ULL;
+   }
+   char name[32];
+   snprintf(name, sizeof(name), "%016llx", h);
+   string ext;
+   size_t dot = source.find_last_of('.');
+   if ((dot != string::npos) && (source.find('/', dot) == string::npos)) ext = source.substr(dot);
+   return name + ext;
+}
+
+// State file: one line per video,  plays <tab> last played <tab> size <tab> mtime <tab> local name <tab> source
+void VideoCache::loadState() {
+   ifstream statefile((cache_dir + CACHE_STATE_FILENAME).c_str());
+   string line;
+   while (getline(statefile, line)) {
+      string field[6];
+      if (!FileIO::splitFields(line, field, 6)) continue;  // damaged line
+
+      int i = findEntry(field[5]);
+      if (i < 0) {
+         // no longer in the list file
+         if (field[4] != "-") unlink((cache_dir + field[4]).c_str());
+         continue;
+      }
+      sscanf(field[0].c_str(), "%d", &entries[i].plays);
+      sscanf(field[1].c_str(), "%ld", &entries[i].last_played);
+      sscanf(field[2].c_str(), "%lld", &entries[i].size);
+      sscanf(field[3].c_str(), "%ld", &entries[i].mtime);
+      if (field[4] != "-") {
+         struct stat st;
+         string local = cache_dir + field[4];
+         if ((stat(local.c_str(), &st) == 0) && (st.st_size == entries[i].size)) {
+            entries[i].local_name = field[4];
+         }
+         else {
+            unlink(local.c_str());
+         }
+      }
+   }
+}
+
+// Contents of the state file.  Caller holds the lock.
+string VideoCache::stateText() {
+   string text;
+   char line[96];
+   for (int i=0; i<entry_count; i++) {
+      if ((entries[i].plays == 0) && entries[i].local_name.empty()) continue;
+      snprintf(line, sizeof(line), "%d\t%ld\t%lld\t%ld\t", entries[i].plays, entries[i].last_played,
+               entries[i].size, entries[i].mtime);
+      text += line;
+      text += entries[i].local_name.empty() ? "-" : entries[i].local_name;
+      text += "\t" + entries[i].source + "\n";
+   }
+   return text;
+}
+
+// Called without the lock, by the copy thread only (or by initialize() before it starts).
+// A failed write leaves the old state file, so the local copies it lists are not lost.
+bool VideoCache::saveState(string text) {
+   if (FileIO::writeFileAtomically(cache_dir + CACHE_STATE_FILENAME, text)) return true;
+   cout << "VC: Cannot save the cache state in " << cache_dir << endl;
+   return false;
+}
+
+// Write the state file if anything changed.  The fsync to the SD card is done without the lock
+// so recordPlay() and localPath() never wait for it.  After a failed write the state stays
+// dirty and is written again on the next pass.  Caller holds the lock.
+void VideoCache::saveIfDirty() {
+   if (!state_dirty) return;
+   string text = stateText();
+   state_dirty = false;
+   pthread_mutex_unlock(&lock);
+   bool saved = saveState(text);
+   pthread_mutex_lock(&lock);
+   if (!saved) state_dirty = true;
+}
+
+// Delete local copies in the cache directory that are no longer in the state file.  This includes
+// partial copies left by a power cut.  Only names made by localName() are touched.
+void VideoCache::removeOrphans() {
+   DIR *dir = opendir(cache_dir.c_str());
+   if (dir == NULL) return;
+   struct dirent *de;
+   while ((de = readdir(dir)) != NULL) {
+      string name = de->d_name;
+      if ((name.length() < 16) || (name.find_first_not_of("0123456789abcdef") < 16)) continue;
+      bool known = false;
+      for (int i=0; i<entry_count; i++) {
+         if (entries[i].local_name == name) known = true;
+      }
+      if (!known) {
+         cout << "VC: Removing stray file " << name << endl;
+         unlink((cache_dir + name).c_str());
+      }
+   }
+   closedir(dir);
+}
+
+// Caller holds the lock
+void VideoCache::dropLocal(int index) {
+   if (entries[index].local_name.empty()) return;
+   unlink((cache_dir + entries[index].local_name).c_str());
+   entries[index].local_name = "";
+   used -= entries[index].size;
+   state_dirty = true;
+}
+
+// Most valuable video that has been played but is not local yet.  Caller holds the lock.
+int VideoCache::pickCandidate() {
+   int best = -1;
+   for (int i=0; i<entry_count; i++) {
+      if ((entries[i].plays == 0) || !entries[i].local_name.empty() || entries[i].copy_failed) continue;
+      if ((best < 0) || moreValuable(i, best)) best = i;
+   }
+   return best;
+}
+
+// Evict less valuable local copies until size bytes fit in the budget and on the disk.
+// Nothing is evicted unless the candidate will fit.  A video that is playing is never evicted.
+// Caller holds the lock.
+bool VideoCache::makeRoom(int candidate, long long size) {
+   if (size > budget) return false;
+   struct statvfs vfs;
+   if (statvfs(cache_dir.c_str(), &vfs) != 0) return false;
+   long long disk_free = (long long)vfs.f_bavail * vfs.f_frsize;
+
+   bool victim[MAXLIBRARYFILES];
+   long long freed = 0;
+   for (int i=0; i<entry_count; i++) victim[i] = false;
+   while ((used - freed + size > budget) || (size + CACHE_DISK_RESERVE > disk_free + freed)) {
+      int worst = -1;
+      for (int i=0; i<entry_count; i++) {
+         if (entries[i].local_name.empty() || victim[i] || isPlaying(i)) continue;
+         if ((worst < 0) || moreValuable(worst, i)) worst = i;
+      }
+      if ((worst < 0) || moreValuable(worst, candidate)) return false;
+      victim[worst] = true;
+      freed += entries[worst].size;
+   }
+   for (int i=0; i<entry_count; i++) {
+      if (victim[i]) {
+         cout << "VC: Evicting " << entries[i].source << endl;
+         dropLocal(i);
+      }
+   }
+   return true;
+}
+
+// Copy one video to the cache directory.  Called without the lock.
+bool VideoCache::copyToLocal(int index, string source, string local_name) {
+   string local = cache_dir + local_name;
+   string partial = local + CACHE_PARTIAL_EXTENSION;
+   struct stat before, after;
+
+   int in_fd = open(source.c_str(), O_RDONLY | O_LARGEFILE);
+   if (in_fd < 0) return false;
+   if (fstat(in_fd, &before) != 0) {
+      close(in_fd);
+      return false;
+   }
+   posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   int out_fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0644);
+   if (out_fd < 0) {
+      close(in_fd);
+      return false;
+   }
+
+   cout << "VC: Copying " << source << " to " << local << endl;
+   long long total = 0;
+   ssize_t n;
+   double start = FileIO::secondsNow();
+   while ((n = FileIO::copyChunk(in_fd, out_fd, CACHE_COPY_CHUNK)) > 0) {
+      total += n;
+      // Hold the average read rate to CACHE_COPY_RATE
+      double ahead = (double)total/CACHE_COPY_RATE - (FileIO::secondsNow() - start);
+      if (ahead > 0) delay((unsigned int)(ahead*1000));
+   }
+   bool ok = (n == 0) && (total == before.st_size) && (fsync(out_fd) == 0);
+   ok = ok && (fstat(in_fd, &after) == 0) && (after.st_mtime == before.st_mtime) && (after.st_size == before.st_size);
+   close(out_fd);
+   close(in_fd);
+   if (!ok || (rename(partial.c_str(), local.c_str()) != 0)) {
+      cout << "VC: Copy of " << source << " failed" << endl;
+      unlink(partial.c_str());
+      return false;
+   }
+
+   pthread_mutex_lock(&lock);
+   entries[index].local_name = local_name;
+   entries[index].size = before.st_size;
+   entries[index].mtime = before.st_mtime;
+   used += before.st_size;
+   state_dirty = true;
+   pthread_mutex_unlock(&lock);
+   cout << "VC: Copy done, " << total/(1024*1024) << " MB" << endl;
+   return true;
+}
+
+void *VideoCache::stagerThread(void *arg) {
+   ((VideoCache *)arg)->stagerLoop();
+   return NULL;
+}
+
+// The copy thread sleeps until a video is played, then copies the most valuable videos
+// that fit.  It runs in the idle I/O class and at a limited rate so it does not slow down the
+// video player.  Without the idle I/O class it only saves the state and never copies.
+void VideoCache::stagerLoop() {
+   copying = FileIO::setIdlePriority();
+   if (!copying) cout << "VC: Cannot set idle I/O priority.  Videos will not be copied to the cache." << endl;
+   pthread_mutex_lock(&lock);
+   for (;;) {
+      saveIfDirty();
+      int candidate;
+      while (copying && ((candidate = pickCandidate()) >= 0)) {
+         string source = entries[candidate].source;
+         pthread_mutex_unlock(&lock);
+         struct stat st;
+         bool found = (stat(source.c_str(), &st) == 0);
+         pthread_mutex_lock(&lock);
+         if (!found || !makeRoom(candidate, st.st_size)) {
+            entries[candidate].copy_failed = true;
+            continue;
+         }
+         string name = localName(source);
+         pthread_mutex_unlock(&lock);
+         bool ok = copyToLocal(candidate, source, name);
+         pthread_mutex_lock(&lock);
+         if (!ok) entries[candidate].copy_failed = true;
+         saveIfDirty();
+      }
+
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += CACHE_IDLE_PERIOD/1000;
+      pthread_cond_timedwait(&wake, &lock, &deadline);
+   } // for (;;)
+}
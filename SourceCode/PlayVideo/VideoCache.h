@@ -0,0 +1,88 @@
+// VideoCache.h
+//
+//  The VideoCache class copies the most played videos from the USB flash drives to local storage
+//  (normally the microSD card) and tells PlayVideo to use the local copy when it is there.
+//  Play counts and the list of local copies are kept in a state file so they survive a reboot.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <pthread.h>
+#include "ListManager.h"
+
+using namespace std;
+
+#ifndef _VIDEOCACHE_H
+#define _VIDEOCACHE_H
+
+// State file kept in the cache directory
+const char CACHE_STATE_FILENAME[] = "cache.txt";
+// Extension of a local copy that is still being written
+const char CACHE_PARTIAL_EXTENSION[] = ".part";
+// Bytes copied per step, and the most bytes per second the copy may read from a flash drive.
+// A USB2 flash drive on a Pi reads 20 to 30 MB/s and a player needs 1 to 2 MB/s, so at this
+// rate the copy takes about a tenth of the drive.  The steps are small so each burst is short.
+const size_t CACHE_COPY_CHUNK = 256*1024;
+const long long CACHE_COPY_RATE = 2*1024*1024;
+// Space left free on the local disk no matter what the budget says
+const long long CACHE_DISK_RESERVE = 512LL*1024*1024;
+// Look for something to copy at least this often (ms), even if nothing was played
+const int CACHE_IDLE_PERIOD = 60000;
+// Most players sharing one cache (one per zone in multi-zone mode)
+const int MAXPLAYERS = 8;
+
+typedef struct cacheentry {
+   string source;       // full path of the video on the flash drive
+   string local_name;   // name of the local copy in the cache directory, empty if not cached
+   long long size;      // size of the source when it was copied
+   long mtime;          // modification time of the source when it was copied
+   int plays;           // number of times this video was started
+   long last_played;    // time of the last start (seconds since 1970)
+   bool copy_failed;    // do not try to copy again until it is played again
+} cacheentry_t;
+
+
+class VideoCache {
+
+   private:
+      string cache_dir;             // with slash at the end
+      long long budget;             // bytes allowed in the cache directory
+      long long used;               // bytes of local copies
+      cacheentry_t entries[MAXLIBRARYFILES];
+      int entry_count;
+      int playing[MAXPLAYERS];      // entry of the video each player is playing, or -1.  Never evicted.
+      bool enabled;
+      bool copying;                 // the copy thread may copy.  False without the idle I/O class.
+      bool state_dirty;             // state changed since the state file was written
+      pthread_mutex_t lock;
+      pthread_cond_t wake;
+      pthread_t stager;
+
+      int findEntry(string source);
+      bool moreValuable(int a, int b);
+      bool isPlaying(int index);
+      string localName(string source);
+      void loadState();
+      string stateText();
+      bool saveState(string text);
+      void saveIfDirty();
+      void removeOrphans();
+      void dropLocal(int index);
+      int pickCandidate();
+      bool makeRoom(int candidate, long long size);
+      bool copyToLocal(int index, string source, string local_name);
+      static void *stagerThread(void *arg);
+      void stagerLoop();
+
+   public:
+      void initialize(string cache_directory, long long budget_mb, ListManager *list_managers[], int list_managers_count);
+      void recordPlay(string source, int player);
+      string localPath(string source);
+
+}; // VideoCache
+
+
+#endif
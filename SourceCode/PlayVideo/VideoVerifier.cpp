@@ -0,0 +1,339 @@
+// VideoVerifier.cpp
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "VideoVerifier.h"
+
+typedef struct verifythreadarg {
+   VideoVerifier *verifier;
+   int drive;
+} verifythreadarg_t;
+
+// Fletcher style sums over 32-bit words, CHECKSUM_LANES words at a time.  The lanes do not
+// depend on each other, so gcc turns the inner loop into NEON (or SSE) vector adds.  The
+// Raspberry Pi build uses -O2, which does not vectorize on older gcc, hence the attribute.
+__attribute__((optimize("tree-vectorize")))
+static void checksumBlocks(uint64_t *a, uint64_t *b, const uint32_t *words, size_t blocks) {
+   for (size_t i=0; i<blocks; i++) {
+      for (int l=0; l<CHECKSUM_LANES; l++) {
+         a[l] += words[l];
+         b[l] += a[l];
+      }
+      words += CHECKSUM_LANES;
+   }
+}
+
+// implementation of class VideoVerifier
+//
+void VideoVerifier::initialize(string results_file, ListManager *list_managers[], int list_managers_count) {
+   results_filename = results_file;
+   list_count = 0;
+   record_count = 0;
+   drive_count = 0;
+   pthread_mutex_init(&lock, NULL);
+   pthread_mutex_init(&save_lock, NULL);
+
+   // One record per video file, across all the list files.  A file listed twice is read once.
+   for (int l=0; (l<list_managers_count) && (list_count<MAXLISTFILES); l++) {
+      ListManager *LM = list_managers[l];
+      lists[list_count++] = LM;
+      for (int i=0; (i<LM->videoCount()) && (record_count<MAXLIBRARYFILES); i++) {
+         string path = LM->videoFilePath(i);
+         if (path.empty() || (findRecord(path) >= 0)) continue;
+         int d = FileIO::driveIndex(path, drives, &drive_count, MAXFLASHDRIVES);
+         if (d < 0) continue;
+         records[record_count].path = path;
+         records[record_count].drive = d;
+         records[record_count].size = 0;
+         records[record_count].mtime = 0;
+         records[record_count].checksum = 0;
+         records[record_count].status = VIDEO_UNCHECKED;
+         records[record_count].verified = 0;
+         records[record_count].claimed = false;
+         record_count++;
+      }
+   }
+   loadResults();
+
+   // Tell the ListManagers what we already know
+   for (int i=0; i<record_count; i++) {
+      if (records[i].status == VIDEO_CORRUPT) {
+         cout << "VV: Known damaged video: " << records[i].path << endl;
+         flagVideo(records[i].path, VIDEO_CORRUPT);
+      }
+   }
+   cout << "VV: " << record_count << " video files on " << drive_count << " drives" << endl;
+} // initialize()
+
+// Start the reader threads.  They run at idle I/O priority and end when every file is checked.
+void VideoVerifier::start() {
+   for (int d=0; d<drive_count; d++) {
+      drive_threads[d] = VERIFY_THREADS_PER_DRIVE;
+      drive_bytes[d] = 0;
+      drive_start[d] = FileIO::secondsNow();
+      throttled[d] = false;
+      for (int t=0; t<VERIFY_THREADS_PER_DRIVE; t++) {
+         verifythreadarg_t *arg = new verifythreadarg_t;
+         arg->verifier = this;
+         arg->drive = d;
+         pthread_t thread;
+         if (pthread_create(&thread, NULL, &VideoVerifier::readerThread, arg) != 0) {
+            cout << "VV: Cannot start a reader thread for " << drives[d] << endl;
+            delete arg;
+            pthread_mutex_lock(&lock);
+            drive_threads[d]--;
+            pthread_mutex_unlock(&lock);
+            continue;
+         }
+         pthread_detach(thread);
+      }
+   }
+} // start()
+
+void VideoVerifier::checksumInit(checksumstate_t *s) {
+   for (int l=0; l<CHECKSUM_LANES; l++) {
+      s->a[l] = 0;
+      s->b[l] = 0;
+   }
+   s->length = 0;
+}
+
+// Every call except the last must pass a multiple of CHECKSUM_LANES*4 bytes.
+// The last call may pass any length; the tail is padded with zeros.
+void VideoVerifier::checksumUpdate(checksumstate_t *s, const unsigned char *data, size_t len) {
+   const size_t block_size = CHECKSUM_LANES*sizeof(uint32_t);
+   size_t blocks = len / block_size;
+   uint32_t block[CHECKSUM_LANES];
+   if (((uintptr_t)data % sizeof(uint32_t)) == 0) {
+      checksumBlocks(s->a, s->b, (const uint32_t *)data, blocks);
+   }
+   else {
+      for (size_t i=0; i<blocks; i++) {
+         memcpy(block, data + i*block_size, block_size);
+         checksumBlocks(s->a, s->b, block, 1);
+      }
+   }
+   size_t tail = len - blocks*block_size;
+   if (tail > 0) {
+      memset(block, 0, block_size);
+      memcpy(block, data + blocks*block_size, tail);
+      checksumBlocks(s->a, s->b, block, 1);
+   }
+   s->length += len;
+}
+
+uint64_t VideoVerifier::checksumFinal(checksumstate_t *s) {
+   uint64_t h = 14695981039346656037ULL ^ s->length;
+   for (int l=0; l<CHECKSUM_LANES; l++) {
+      h = (h ^ s->a[l]) * 1099511628211ULL;
+      h = (h ^ s->b[l]) * 1099511628211ULL;
+   }
+   return h;
+}
+
+int VideoVerifier::findRecord(string path) {
+   for (int i=0; i<record_count; i++) {
+      if (records[i].path == path) return i;
+   }
+   return -1;
+}
+
+// Report to every list that has this file
+void VideoVerifier::flagVideo(string path, int status) {
+   for (int l=0; l<list_count; l++) lists[l]->flagVideo(path, CHECKER_VERIFIER, status);
+}
+
+// Results file: one line per video,  status <tab> verified <tab> size <tab> mtime <tab> checksum <tab> path
+void VideoVerifier::loadResults() {
+   ifstream resultsfile(results_filename.c_str());
+   string line;
+   while (getline(resultsfile, line)) {
+      string field[6];
+      if (!FileIO::splitFields(line, field, 6)) continue;  // damaged line
+
+      int i = findRecord(field[5]);
+      if (i < 0) continue;  // no longer in the list file
+      unsigned long long checksum;
+      sscanf(field[0].c_str(), "%d", &records[i].status);
+      sscanf(field[1].c_str(), "%ld", &records[i].verified);
+      sscanf(field[2].c_str(), "%lld", &records[i].size);
+      sscanf(field[3].c_str(), "%ld", &records[i].mtime);
+      sscanf(field[4].c_str(), "%llx", &checksum);
+      records[i].checksum = checksum;
+   }
+}
+
+// Contents of the results file.  Caller holds the lock.
+string VideoVerifier::resultsText() {
+   string text;
+   char line[128];
+   for (int i=0; i<record_count; i++) {
+      if (records[i].verified == 0) continue;
+      snprintf(line, sizeof(line), "%d\t%ld\t%lld\t%ld\t%016llx\t", records[i].status, records[i].verified,
+               records[i].size, records[i].mtime, (unsigned long long)records[i].checksum);
+      text += line + records[i].path + "\n";
+   }
+   return text;
+}
+
+// Called without the lock, so the other readers do not wait for the fsync to the SD card.
+// save_lock keeps two readers from writing the file at the same time, and the text is taken
+// under it so an older text never replaces a newer one.
+void VideoVerifier::saveResults() {
+   pthread_mutex_lock(&save_lock);
+   pthread_mutex_lock(&lock);
+   string text = resultsText();
+   pthread_mutex_unlock(&lock);
+   if (!FileIO::writeFileAtomically(results_filename, text)) {
+      cout << "VV: Cannot save the results in " << results_filename << endl;
+   }
+   pthread_mutex_unlock(&save_lock);
+}
+
+// Read the whole file with large sequential reads.  Returns false on a read error or if the
+// file ends early.  Pages are dropped from the page cache as we go so the player keeps its own.
+bool VideoVerifier::readFile(string path, int drive, uint64_t *checksum) {
+   int fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+   if (fd < 0) return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+   }
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   void *buffer;
+   if (posix_memalign(&buffer, 4096, VERIFY_READ_SIZE) != 0) {
+      close(fd);
+      return false;
+   }
+
+   checksumstate_t sum;
+   checksumInit(&sum);
+   long long offset = 0;
+   bool ok = true;
+   for (;;) {
+      // Fill the whole buffer so only the last update has a partial block
+      size_t filled = 0;
+      while (filled < VERIFY_READ_SIZE) {
+         ssize_t n = read(fd, (char *)buffer + filled, VERIFY_READ_SIZE - filled);
+         if (n < 0 && errno == EINTR) continue;
+         if (n < 0) ok = false;
+         if (n <= 0) break;
+         filled += n;
+      }
+      if (!ok || (filled == 0)) break;
+      checksumUpdate(&sum, (const unsigned char *)buffer, filled);
+      posix_fadvise(fd, offset, filled, POSIX_FADV_DONTNEED);
+      offset += filled;
+      pthread_mutex_lock(&lock);
+      drive_bytes[drive] += filled;
+      bool pause = throttled[drive];
+      pthread_mutex_unlock(&lock);
+      if (filled < VERIFY_READ_SIZE) break;
+      if (pause) delay(VERIFY_THROTTLED_PAUSE);
+   }
+   free(buffer);
+   close(fd);
+   if (offset != st.st_size) ok = false;
+   *checksum = checksumFinal(&sum);
+   return ok;
+}
+
+// Check one file.  Called without the lock; the record is claimed by this thread.
+void VideoVerifier::verifyOne(int index) {
+   pthread_mutex_lock(&lock);
+   verifyrecord_t rec = records[index];
+   pthread_mutex_unlock(&lock);
+
+   struct stat st;
+   if (stat(rec.path.c_str(), &st) != 0) return;  // missing files are reported by PlayVideo
+   bool known = (rec.verified != 0);
+   bool changed = known && ((st.st_size != rec.size) || (st.st_mtime != rec.mtime));
+   bool fresh = (time(NULL) - rec.verified) < VERIFY_RECHECK_DAYS*24*3600;
+   if (!changed && fresh && ((rec.status == VIDEO_OK) || (rec.status == VIDEO_CHANGED))) {
+      flagVideo(rec.path, VIDEO_OK);
+      return;
+   }
+
+   double t0 = FileIO::secondsNow();
+   uint64_t checksum;
+   bool ok = readFile(rec.path, rec.drive, &checksum);
+   double seconds = FileIO::secondsNow() - t0;
+
+   int status;
+   if (!ok) status = VIDEO_CORRUPT;
+   else if (!known) status = VIDEO_OK;
+   else if (changed) status = VIDEO_CHANGED;
+   else if (checksum == rec.checksum) status = VIDEO_OK;
+   else status = VIDEO_CORRUPT;  // same size and date, different contents
+
+   cout << "VV: " << rec.path << ": " << (status == VIDEO_OK ? "OK" : status == VIDEO_CHANGED ? "changed" : "DAMAGED");
+   if (ok && (seconds > 0)) cout << "  " << (st.st_size/(1024.0*1024.0))/seconds << " MB/s";
+   cout << endl;
+   flagVideo(rec.path, status);
+
+   pthread_mutex_lock(&lock);
+   records[index].status = status;
+   // Only a clean full read becomes the checksum later reads are compared with.  After a read
+   // error the old checksum (if any) is kept, and a file never read cleanly stays unchecked so
+   // the next run reads it again.  The same goes for a mismatch: the last good checksum stays.
+   if (ok && (status != VIDEO_CORRUPT)) {
+      records[index].checksum = checksum;
+      records[index].size = st.st_size;
+      records[index].mtime = st.st_mtime;
+      records[index].verified = time(NULL);
+   }
+   pthread_mutex_unlock(&lock);
+   saveResults();
+}
+
+void *VideoVerifier::readerThread(void *arg) {
+   verifythreadarg_t *a = (verifythreadarg_t *)arg;
+   VideoVerifier *verifier = a->verifier;
+   int drive = a->drive;
+   delete a;
+   verifier->readerLoop(drive);
+   return NULL;
+}
+
+// Without the idle I/O class the readers would compete with the player at normal priority.
+// Then only one reader per drive keeps going, and it pauses after every read.
+void VideoVerifier::readerLoop(int drive) {
+   bool reading = true;
+   if (!FileIO::setIdlePriority()) {
+      pthread_mutex_lock(&lock);
+      if (throttled[drive]) reading = false;  // another reader on this drive already fell back
+      throttled[drive] = true;
+      pthread_mutex_unlock(&lock);
+      if (reading) cout << "VV: Cannot set idle I/O priority.  Reading " << drives[drive] << " slowly with one reader." << endl;
+   }
+   while (reading) {
+      int index = -1;
+      pthread_mutex_lock(&lock);
+      for (int i=0; i<record_count; i++) {
+         if ((records[i].drive == drive) && !records[i].claimed) {
+            records[i].claimed = true;
+            index = i;
+            break;
+         }
+      }
+      pthread_mutex_unlock(&lock);
+      if (index < 0) break;
+      verifyOne(index);
+   }
+
+   // The last reader on a drive reports its throughput
+   pthread_mutex_lock(&lock);
+   drive_threads[drive]--;
+   if (drive_threads[drive] == 0) {
+      double seconds = FileIO::secondsNow() - drive_start[drive];
+      double mb = drive_bytes[drive]/(1024.0*1024.0);
+      cout << "VV: Done with " << drives[drive] << ": read " << mb << " MB in " << seconds << " s";
+      if (seconds > 0) cout << " (" << mb/seconds << " MB/s)";
+      cout << endl;
+   }
+   pthread_mutex_unlock(&lock);
+}
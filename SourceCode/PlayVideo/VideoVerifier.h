@@ -0,0 +1,91 @@
+// VideoVerifier.h
+//
+//  The VideoVerifier class reads every video in the list in the background and keeps a checksum
+//  of each file.  Files that cannot be read, or whose contents changed while the size and date
+//  stayed the same (bit rot on an old flash drive), are flagged to ListManager as damaged.
+//  Results are kept in a file so unchanged files are not read again on every startup.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <pthread.h>
+#include "ListManager.h"
+#include "FileIO.cpp"
+
+using namespace std;
+
+#ifndef _VIDEOVERIFIER_H
+#define _VIDEOVERIFIER_H
+
+// Reader threads for each flash drive
+const int VERIFY_THREADS_PER_DRIVE = 2;
+// Size of each read.  Large sequential reads are fastest on USB flash drives.
+const size_t VERIFY_READ_SIZE = 4*1024*1024;
+// Pause after each read (ms) when the idle I/O class cannot be set.  One reader per drive then
+// reads at most about 4 MB/s, a small part of what the drive can deliver to the player.
+const int VERIFY_THROTTLED_PAUSE = 1000;
+// A file that checked out OK is read again after this many days to catch bit rot
+const long VERIFY_RECHECK_DAYS = 30;
+// Checksum lanes.  Each lane is summed independently so the compiler can use vector instructions.
+const int CHECKSUM_LANES = 8;
+
+typedef struct checksumstate {
+   uint64_t a[CHECKSUM_LANES];
+   uint64_t b[CHECKSUM_LANES];
+   uint64_t length;
+} checksumstate_t;
+
+typedef struct verifyrecord {
+   string path;                // full path of the video file
+   int drive;                  // index into drives[]
+   long long size;             // size and modification time when last read
+   long mtime;
+   uint64_t checksum;
+   int status;                 // VIDEO_OK, VIDEO_CHANGED, VIDEO_CORRUPT
+   long verified;              // time of the last full read, 0 if never read
+   bool claimed;               // a reader thread has taken this file on this run
+} verifyrecord_t;
+
+
+class VideoVerifier {
+
+   private:
+      string results_filename;
+      ListManager *lists[MAXLISTFILES];
+      int list_count;
+      verifyrecord_t records[MAXLIBRARYFILES];
+      int record_count;
+      string drives[MAXFLASHDRIVES];
+      int drive_count;
+      int drive_threads[MAXFLASHDRIVES];       // reader threads still running on each drive
+      long long drive_bytes[MAXFLASHDRIVES];   // bytes read from each drive
+      double drive_start[MAXFLASHDRIVES];      // seconds
+      bool throttled[MAXFLASHDRIVES];          // no idle I/O class: one reader, pausing between reads
+      pthread_mutex_t lock;
+      pthread_mutex_t save_lock;               // held while the results file is written
+
+      int findRecord(string path);
+      void flagVideo(string path, int status);
+      void loadResults();
+      string resultsText();
+      void saveResults();
+      bool readFile(string path, int drive, uint64_t *checksum);
+      void verifyOne(int index);
+      static void *readerThread(void *arg);
+      void readerLoop(int drive);
+
+   public:
+      void initialize(string results_file, ListManager *list_managers[], int list_managers_count);
+      void start();
+      static void checksumInit(checksumstate_t *s);
+      static void checksumUpdate(checksumstate_t *s, const unsigned char *data, size_t len);
+      static uint64_t checksumFinal(checksumstate_t *s);
+
+}; // VideoVerifier
+
+
+#endif
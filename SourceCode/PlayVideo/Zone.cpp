@@ -0,0 +1,130 @@
+// Zone.cpp
+
+#include "Zone.h"
+
+// implementation of class Zone
+//
+void Zone::initialize(string zone_name, int forward_button, int reverse_button, ListManager &library,
+                      string player_filename, string player_options, int bounce) {
+   name = zone_name;
+   forward_pin = forward_button;
+   reverse_pin = reverse_button;
+   bounce_time = bounce;
+   list.shareList(library);  // every zone with the same list file shares one copy of it
+   play.initialize(player_filename, player_options);
+   play.useProcessGroup();   // so this zone can stop its own player
+   video = list.currentVideo();
+   video_found = false;
+   state = ZONE_START;
+   switching = false;
+   forward = true;
+   forward_flag = 0;
+   reverse_flag = 0;
+   clearStatistics();
+   cout << "Zone " << name << ": buttons " << forward_pin << "/" << reverse_pin << "  options " << player_options << endl;
+}
+
+// Called from the event loop.  Does at most one step and never waits.
+void Zone::poll(unsigned int now) {
+   switch (state) {
+      case ZONE_START:
+         video_found = false;
+         if (!video.dvd_filename.empty()) {
+            cout << "Zone " << name << ": Playing this file: " << video.dvd_filename << endl;
+            video_found = play.playStart(video);
+            if (!video_found) cout << "Zone " << name << ": That video was not found on the disk." << endl;
+         }
+         else {
+            cout << "Zone " << name << ": Video name is empty string" << endl;
+         }
+         if (switching) {  // time from button press to new player started
+            unsigned int latency = millis() - press_time;
+            switches++;
+            latency_total += latency;
+            if (latency > latency_max) latency_max = latency;
+            switching = false;
+         }
+         settle_until = now + bounce_time;
+         state = ZONE_SETTLE;
+         break;
+
+      case ZONE_SETTLE:
+         if ((int)(now - settle_until) < 0) break;
+         // if the user is holding down a button continuously, allow another step
+         if (forward_pin != NO_PIN) {
+            if (!digitalRead(forward_pin)) forwardPressed();
+            if (!digitalRead(reverse_pin)) reversePressed();
+         }
+         state = ZONE_IDLE;
+         break;
+
+      case ZONE_IDLE:
+         if (!forward_flag && !reverse_flag) break;
+         forward = (forward_flag != 0);  // Only one button at a time.  Forward wins.
+         switching = true;
+         if (video_found) play.playStop();
+         state = ZONE_STOPPING;
+         break;
+
+      case ZONE_STOPPING:
+         if (video_found && !play.playStopped()) break;
+         if (forward) {
+            cout << "Zone " << name << ": ********** Forward button." << endl;
+            video = list.nextVideo();
+         }
+         else {
+            cout << "Zone " << name << ": ********** Reverse button." << endl;
+            video = list.previousVideo();
+         }
+         forward_flag = 0;
+         reverse_flag = 0;
+         state = ZONE_START;
+         break;
+   } // switch
+} // poll()
+
+// Called by the button interrupt routines, or by the load test
+void Zone::forwardPressed() {
+   if (!forward_flag && !reverse_flag) press_time = millis();
+   forward_flag = 1;
+}
+
+void Zone::reversePressed() {
+   if (!forward_flag && !reverse_flag) press_time = millis();
+   reverse_flag = 1;
+}
+
+// Stop the player and wait for it to quit
+void Zone::stop() {
+   if (!video_found) return;
+   play.playStop();
+   while (!play.playStopped()) delay(10);
+   video_found = false;
+}
+
+PlayVideo &Zone::player() {
+   return play;
+}
+
+string Zone::zoneName() {
+   return name;
+}
+
+long Zone::switchCount() {
+   return switches;
+}
+
+double Zone::meanLatency() {
+   if (switches == 0) return 0;
+   return (double)latency_total / switches;
+}
+
+unsigned int Zone::maxLatency() {
+   return latency_max;
+}
+
+void Zone::clearStatistics() {
+   switches = 0;
+   latency_total = 0;
+   latency_max = 0;
+}
@@ -0,0 +1,70 @@
+// Zone.h
+//
+//  A Zone is one user station in multi-zone mode: a forward and reverse button, a place in a list of
+//  videos, and a video player.  Zones never block.  ZoneManager calls poll() for every zone from one
+//  event loop, and each call moves the zone along by at most one step.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <wiringPi.h>
+#include "ListManager.h"
+#include "PlayVideo.h"
+
+using namespace std;
+
+#ifndef _ZONE_H
+#define _ZONE_H
+
+// Zone states
+const int ZONE_START    = 0;   // start the current video
+const int ZONE_SETTLE   = 1;   // video started, give the user time to see it (bounce time)
+const int ZONE_IDLE     = 2;   // wait for a button
+const int ZONE_STOPPING = 3;   // wait for the old player to quit
+
+// Pin number used when a zone has no buttons (simulated input)
+const int NO_PIN = -1;
+
+
+class Zone {
+
+   private:
+      string name;
+      int forward_pin;
+      int reverse_pin;
+      int bounce_time;                    // ms
+      ListManager list;
+      PlayVideo play;
+      videospec_t video;
+      bool video_found;
+      int state;
+      unsigned int settle_until;          // millis()
+      bool forward;                       // direction of the switch in progress
+      bool switching;                     // a button press is being handled
+      volatile int forward_flag;
+      volatile int reverse_flag;
+      volatile unsigned int press_time;   // millis() of the press being handled
+      long switches;                      // switch latency statistics
+      unsigned long latency_total;
+      unsigned int latency_max;
+
+   public:
+      void initialize(string zone_name, int forward_button, int reverse_button, ListManager &library,
+                      string player_filename, string player_options, int bounce);
+      void poll(unsigned int now);
+      void forwardPressed();
+      void reversePressed();
+      void stop();
+      PlayVideo &player();
+      string zoneName();
+      long switchCount();
+      double meanLatency();
+      unsigned int maxLatency();
+      void clearStatistics();
+
+}; // Zone
+
+
+#endif
@@ -0,0 +1,197 @@
+// ZoneManager.cpp
+
+#include "ZoneManager.h"
+
+// wiringPiISR() takes a function with no arguments, so each zone slot gets its own pair of
+// interrupt routines that find their zone in this table.
+static Zone *isr_zone[MAXZONES];
+
+template <int Z> static void zoneForwardISR(void) {
+   isr_zone[Z]->forwardPressed();
+}
+template <int Z> static void zoneReverseISR(void) {
+   isr_zone[Z]->reversePressed();
+}
+
+static void (*forward_isr[MAXZONES])(void) = {
+   zoneForwardISR<0>, zoneForwardISR<1>, zoneForwardISR<2>, zoneForwardISR<3>,
+   zoneForwardISR<4>, zoneForwardISR<5>, zoneForwardISR<6>, zoneForwardISR<7>
+};
+static void (*reverse_isr[MAXZONES])(void) = {
+   zoneReverseISR<0>, zoneReverseISR<1>, zoneReverseISR<2>, zoneReverseISR<3>,
+   zoneReverseISR<4>, zoneReverseISR<5>, zoneReverseISR<6>, zoneReverseISR<7>
+};
+
+// Read one "Name:  value kB" line from /proc/self/status
+static long procStatus(const char *field) {
+   ifstream status("/proc/self/status");
+   string line;
+   long value = -1;
+   while (getline(status, line)) {
+      if (line.compare(0, strlen(field), field) == 0) sscanf(line.c_str() + strlen(field), ": %ld", &value);
+   }
+   return value;
+}
+
+// implementation of class ZoneManager
+//
+bool ZoneManager::initialize(string zone_filename, string player_filename, int bounce) {
+   zone_count = 0;
+   library_count = 0;
+
+   ifstream zonefile(zone_filename.c_str());
+   if (!zonefile.is_open()) {
+      cout << "ZM: Cannot open zone file " << zone_filename << endl;
+      return false;
+   }
+   string line;
+   while (getline(zonefile, line)) {
+      size_t cr = line.find('\r');  // file may come from a DOS/Windows machine
+      if (cr != string::npos) line.erase(cr);
+      size_t first = line.find_first_not_of(whitespace);
+      if ((first == string::npos) || (line.at(first) == LIST_FILE_COMMENT_MARK)) continue;
+
+      istringstream fields(line);
+      string name, list_file, options;
+      int forward_button = NO_PIN, reverse_button = NO_PIN;
+      fields >> name >> forward_button >> reverse_button >> list_file;
+      getline(fields, options);
+      size_t start = options.find_first_not_of(whitespace);
+      options = (start == string::npos) ? "" : options.substr(start);
+      if (fields.bad() || list_file.empty() || (forward_button < 0) || (reverse_button < 0)) {
+         cout << "ZM: invalid zone line, skipping: " << line << endl;
+         continue;
+      }
+      if (!addZone(name, forward_button, reverse_button, list_file, player_filename, options, bounce)) break;
+   }
+   cout << "ZM: " << zone_count << " zones sharing " << library_count << " video lists" << endl;
+   return zone_count > 0;
+} // initialize()
+
+bool ZoneManager::addZone(string name, int forward_button, int reverse_button, string list_file,
+                          string player_filename, string player_options, int bounce) {
+   if (zone_count == MAXZONES) {
+      cout << "ZM: Too many zones.  The limit is " << MAXZONES << endl;
+      return false;
+   }
+   ListManager *library = libraryFor(list_file);
+   if (library == NULL) return false;
+   Zone *zone = &zones[zone_count];
+   zone->initialize(name, forward_button, reverse_button, *library, player_filename, player_options, bounce);
+   if (forward_button != NO_PIN) {
+      isr_zone[zone_count] = zone;
+      pinMode(forward_button, INPUT);
+      pinMode(reverse_button, INPUT);
+      pullUpDnControl(forward_button, PUD_UP);
+      pullUpDnControl(reverse_button, PUD_UP);
+      wiringPiISR(forward_button, INT_EDGE_FALLING, forward_isr[zone_count]);
+      wiringPiISR(reverse_button, INT_EDGE_FALLING, reverse_isr[zone_count]);
+   }
+   zone_count++;
+   return true;
+}
+
+// Each list file is read once, no matter how many zones use it
+ListManager *ZoneManager::libraryFor(string list_file) {
+   for (int i=0; i<library_count; i++) {
+      if (library_files[i] == list_file) return &libraries[i];
+   }
+   if (library_count == MAXLISTFILES) return NULL;
+   cout << "ZM: Fetching list of videos " << list_file << endl;
+   libraries[library_count].initialize(list_file);
+   library_files[library_count] = list_file;
+   return &libraries[library_count++];
+}
+
+int ZoneManager::zoneCount() {
+   return zone_count;
+}
+
+ListManager *ZoneManager::library(int index) {
+   return &libraries[index];
+}
+
+int ZoneManager::libraryCount() {
+   return library_count;
+}
+
+void ZoneManager::useCache(VideoCache *video_cache) {
+   for (int z=0; z<zone_count; z++) zones[z].player().useCache(video_cache, z);
+}
+
+void ZoneManager::useMediaIndex(MediaIndex *media_index) {
+   for (int z=0; z<zone_count; z++) zones[z].player().useMediaIndex(media_index);
+}
+
+// One pass of the event loop
+void ZoneManager::step(unsigned int now) {
+   for (int z=0; z<zone_count; z++) zones[z].poll(now);
+}
+
+void ZoneManager::run() {
+   for (;;) {
+      step(millis());
+      delay(ZONE_POLL_PERIOD);
+   }
+}
+
+void ZoneManager::stopAll() {
+   for (int z=0; z<zone_count; z++) zones[z].stop();
+}
+
+// Simulated button presses for 1, 2, ... max_zones zones, with a stand-in player.  For each zone
+// count, report the switch latency (button press to new player started) and the memory and
+// threads used.  The latency should not grow as zones are added.
+void ZoneManager::loadTest(int max_zones, string list_file) {
+   if (max_zones > MAXZONES) max_zones = MAXZONES;
+   library_count = 0;
+   printf("LT: zones  switches  mean ms  max ms  worst zone mean ms  RSS kB  threads\n");
+   for (int n=1; n<=max_zones; n++) {
+      zone_count = 0;
+      char name[16];
+      for (int z=0; z<n; z++) {
+         snprintf(name, sizeof(name), "LT%d", z+1);
+         addZone(name, NO_PIN, NO_PIN, list_file, LOADTEST_PLAYER, "", LOADTEST_BOUNCE_TIME);
+      }
+
+      // Presses in different zones are spread out over the press period
+      unsigned int start = millis();
+      unsigned int next_press[MAXZONES];
+      int presses[MAXZONES];
+      for (int z=0; z<n; z++) {
+         next_press[z] = start + LOADTEST_PRESS_PERIOD + z*LOADTEST_PRESS_PERIOD/n;
+         presses[z] = 0;
+      }
+      unsigned int give_up = start + (LOADTEST_PRESSES+2)*LOADTEST_PRESS_PERIOD + 10000;
+      for (;;) {
+         unsigned int now = millis();
+         bool done = true;
+         for (int z=0; z<n; z++) {
+            if ((presses[z] < LOADTEST_PRESSES) && ((int)(now - next_press[z]) >= 0)) {
+               zones[z].forwardPressed();
+               presses[z]++;
+               next_press[z] += LOADTEST_PRESS_PERIOD;
+            }
+            if (zones[z].switchCount() < LOADTEST_PRESSES) done = false;
+         }
+         if (done || ((int)(now - give_up) >= 0)) break;
+         step(now);
+         delay(ZONE_POLL_PERIOD);
+      }
+
+      long switches = 0;
+      double total = 0, worst_mean = 0;
+      unsigned int worst = 0;
+      for (int z=0; z<n; z++) {
+         switches += zones[z].switchCount();
+         total += zones[z].meanLatency() * zones[z].switchCount();
+         if (zones[z].maxLatency() > worst) worst = zones[z].maxLatency();
+         if (zones[z].meanLatency() > worst_mean) worst_mean = zones[z].meanLatency();
+      }
+      printf("LT: %5d  %8ld  %7.1f  %6u  %18.1f  %6ld  %7ld\n", n, switches,
+             switches ? total/switches : 0.0, worst, worst_mean, procStatus("VmRSS"), procStatus("Threads"));
+      fflush(stdout);
+      stopAll();
+   }
+   zone_count = 0;
+} // loadTest()
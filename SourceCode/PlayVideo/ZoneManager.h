@@ -0,0 +1,70 @@
+// ZoneManager.h
+//
+//  The ZoneManager class runs several independent jukeboxes (zones) from one process and one event loop.
+//  Each zone has its own buttons, place in the list, player options and player process.  Zones that
+//  name the same list file share one parsed copy of it.
+//
+//  Zone file (environment variable DVDZONEFILE).  One zone per line.  '*' starts a comment.
+//     name   forward-pin  reverse-pin  list-file                   player options (rest of line)
+//     DEN    2            3            /media/pi/VIDEOS/list.txt   --adev hdmi --display 2 --no-keys
+//     PORCH  17           27           /media/pi/VIDEOS/list.txt   --adev local --display 7 --no-keys
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <wiringPi.h>
+#include "ListManager.h"
+#include "PlayVideo.h"
+#include "Zone.h"
+
+using namespace std;
+
+#ifndef _ZONEMANAGER_H
+#define _ZONEMANAGER_H
+
+// Most zones in one process.  Each zone has its own player in the cache.
+const int MAXZONES = MAXPLAYERS;
+// Event loop period (ms)
+const int ZONE_POLL_PERIOD = 10;
+
+// Load test settings.  The load test uses a stand-in player that just sleeps.  The '#' makes
+// the shell ignore the options PlayVideo adds after the player name.
+const char LOADTEST_PLAYER[] = "sleep 3600 #";
+const int LOADTEST_PRESSES = 10;         // button presses per zone
+const int LOADTEST_PRESS_PERIOD = 700;   // ms between presses in one zone
+const int LOADTEST_BOUNCE_TIME = 120;    // ms
+
+
+class ZoneManager {
+
+   private:
+      Zone zones[MAXZONES];
+      int zone_count;
+      ListManager libraries[MAXLISTFILES];
+      string library_files[MAXLISTFILES];
+      int library_count;
+
+      ListManager *libraryFor(string list_file);
+      void stopAll();
+
+   public:
+      bool initialize(string zone_filename, string player_filename, int bounce);
+      bool addZone(string name, int forward_button, int reverse_button, string list_file,
+                   string player_filename, string player_options, int bounce);
+      int zoneCount();
+      ListManager *library(int index);
+      int libraryCount();
+      void useCache(VideoCache *video_cache);
+      void useMediaIndex(MediaIndex *media_index);
+      void step(unsigned int now);
+      void run();
+      void loadTest(int max_zones, string list_file);
+
+}; // ZoneManager
+
+
+#endif
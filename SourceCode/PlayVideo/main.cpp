@@ -59,6 +59,23 @@
 //                   "--adev local"    play audio through the Raspberry Pi speaker jack
 //                   "--adev both"     play audio through both
 //            Other options can be included, like:  --win \"100 100 450 450\"   small video window on the desktop
+//  These environment variables are optional.  If both are set, the most played videos are copied from the
+//  flash drives to local storage and played from there.  See VideoCache.
+//  DVDCACHEDIR="/home/pi/VideoCache"     directory for the local copies (created if needed)
+//  DVDCACHESIZE="8000"                   most space the local copies may use, in MB
+//  DVDVERIFYFILE="/home/pi/verify.txt"   if set, every video is read in the background and checked for damage.
+//                                        Results are kept in this file.  See VideoVerifier.
+//  DVDINDEXFILE="/home/pi/index.txt"     if set, the MP4 boxes of every video are probed at startup (duration, codecs,
+//                                        bit rate, moov location).  Results are kept in this file.  See MediaIndex.
+//  DVDZONEFILE="/home/pi/zones.txt"      if set, run several jukeboxes (zones) from this one program.  Each line of the
+//                                        file gives a zone's buttons, list file and player options.  See ZoneManager.
+//                                        DVDLISTFILE and DVDPLAYEROPTIONS are not used in this mode, nor are the buttons
+//                                        on GPIO 2 and 3 or the HDMI audio jumper.  One cache, index and checker cover
+//                                        the videos of every list file in the zone file.
+//
+//  Multi-zone load test:  PlayVideo --loadtest N
+//  Runs 1 to N zones on the videos in DVDLISTFILE with simulated button presses and a stand-in player, and
+//  reports the switch latency, memory and threads for each number of zones.
 //
 //  Two pushbuttons are supported, one to step forward and one backward through the list of file names.
 //  These buttons connect to general purpose I/O (GPIO) pins and use the WiringPi utilities
@@ -118,19 +135,31 @@
 //  v 1.7   4 Nov 2017   Prepend the file name with the @ sign to make that video loop indefinitely.
 //  v 1.8   5 Nov 2017   Bug in PlayVideo caused files greater than 2.147 GB to not be found. (fopen() replaced with fopen64())
 //  v 1.9   5 Nov 2017   ListManager now tries 6 times to open the list directory
+//  v 2.0  19 Oct 2026  VideoCache copies the most played videos to local storage in the background and PlayVideo
+//                       plays the local copy when it is good.  Play counts survive a reboot.
+//  v 2.1  19 Oct 2026  VideoVerifier reads every video in the background at idle I/O priority and keeps a checksum
+//                       of each file.  ListManager skips videos that are damaged.
+//  v 2.2  19 Oct 2026  MediaIndex probes the MP4 box headers of every video, one thread per flash drive, and flags
+//                       broken MP4 files to ListManager.  PlayVideo logs duration, codecs, bit rate and moov location.
+//  v 2.3  19 Oct 2026  Multi-zone mode: ZoneManager runs several zones from one event loop.  Each zone stops only its
+//                       own player (process group) instead of killall.  Zones with the same list file share it.
+//                       One cache, index and checker serve the list files of all zones.
 // please update the VERSION string with each new version.
 
 #include <iostream>
 #include "PlayVideo.h"
 #include <stdlib.h>
+#include <string.h>
 #include <wiringPi.h>
 #include "ListManager.h"
+#include "VideoVerifier.h"
+#include "ZoneManager.h"
 #include <linux/reboot.h>
 #include "ExecuteCommand.cpp"
 
 using namespace std;
 
-const string VERSION = "v 1.9  5 Nov 2017";
+const string VERSION = "v 2.3  19 Oct 2026";
 
 
 //	GPIO pin numbers
@@ -146,9 +175,21 @@ static volatile int reverseButtonFlag =  0 ;
 const char LIST_FILE_ENV_VAR[] = "DVDLISTFILE";
 const char DVD_PLAYER_ENV_VAR[] = "DVDPLAYER";
 const char DVD_PLAYER_OPTIONS_ENV_VAR[] = "DVDPLAYEROPTIONS";
+const char CACHE_DIR_ENV_VAR[] = "DVDCACHEDIR";
+const char CACHE_SIZE_ENV_VAR[] = "DVDCACHESIZE";
+const char VERIFY_FILE_ENV_VAR[] = "DVDVERIFYFILE";
+const char INDEX_FILE_ENV_VAR[] = "DVDINDEXFILE";
+const char ZONE_FILE_ENV_VAR[] = "DVDZONEFILE";
 
 static int MyPID = 0;
 
+// Optional services for the video library
+static VideoCache cache;
+static MediaIndex media;
+static VideoVerifier verifier;
+static bool use_cache = false;
+static bool use_index = false;
+
 // SLOW_BOUNCETIME allows the user to see each video start before moving on
 // to next video
 const int FAST_BOUNCETIME    = 120;   // milliseconds
@@ -161,10 +202,80 @@ void reverseButtonISR (void) {
   reverseButtonFlag=1 ;
 }
 
+// Start the optional local cache, MP4 index and background checker for one or more lists of videos.
+// A video in several lists is cached, probed and checked once, and reported to every list.
+void startLibraryServices(ListManager *lists[], int list_count) {
+   // LOCAL COPIES OF POPULAR VIDEOS (optional)
+   char *cache_dir=getenv(CACHE_DIR_ENV_VAR);
+   char *cache_size=getenv(CACHE_SIZE_ENV_VAR);
+   if ((cache_dir != NULL) && (cache_size != NULL)) {
+      cout << "Using local video cache: " << cache_dir << endl;
+      cache.initialize(cache_dir, atoll(cache_size), lists, list_count);
+      use_cache = true;
+   }
+   else {
+      cout << "No local video cache" << endl;
+   }
+
+   // PROBE THE MP4 FILES IN THE BACKGROUND (optional)
+   char *index_file=getenv(INDEX_FILE_ENV_VAR);
+   if (index_file != NULL) {
+      cout << "Indexing video files, results in: " << index_file << endl;
+      media.initialize(index_file, lists, list_count);
+      media.start();
+      use_index = true;
+   }
 
-int main()  {
+   // CHECK THE VIDEO FILES IN THE BACKGROUND (optional)
+   char *verify_file=getenv(VERIFY_FILE_ENV_VAR);
+   if (verify_file != NULL) {
+      cout << "Checking video files, results in: " << verify_file << endl;
+      verifier.initialize(verify_file, lists, list_count);
+      verifier.start();
+   }
+} // startLibraryServices
+
+// Multi-zone mode.  Never returns.
+void runZones(char *zone_file_name) {
+   static ZoneManager zones;  // large, keep it off the stack
+
+   char *player_file_name=getenv(DVD_PLAYER_ENV_VAR);
+   if (player_file_name == NULL) {
+      cout << " Environment variable " << DVD_PLAYER_ENV_VAR << " not found.  Quitting!" << endl;
+      exit(-1);
+   }
+   int bounce_time = SLOW_BOUNCETIME;
+   if (!digitalRead(FAST_DEBOUNCE)) bounce_time = FAST_BOUNCETIME;  // select fast bounce time if jumper installed
+
+   cout << "Multi-zone mode.  Zone file: " << zone_file_name << endl;
+   if (!zones.initialize(zone_file_name, player_file_name, bounce_time)) {
+      cout << "No zones found.  Quitting!" << endl;
+      exit(-1);
+   }
+   ListManager *lists[MAXLISTFILES];
+   for (int i=0; i<zones.libraryCount(); i++) lists[i] = zones.library(i);
+   startLibraryServices(lists, zones.libraryCount());
+   if (use_cache) zones.useCache(&cache);
+   if (use_index) zones.useMediaIndex(&media);
+   zones.run();
+} // runZones
+
+
+int main(int argc, char *argv[])  {
    cout << "PlayVideo " << VERSION << endl;
 
+   // Multi-zone load test.  No buttons and no real player, so it can run next to the jukebox.
+   if ((argc >= 3) && (strcmp(argv[1], "--loadtest") == 0)) {
+      char *list_file_name=getenv(LIST_FILE_ENV_VAR);
+      if (list_file_name == NULL) {
+         cout << " Environment variable " << LIST_FILE_ENV_VAR << " not found.  Quitting!" << endl;
+         exit(-1);
+      }
+      static ZoneManager zones;
+      zones.loadTest(atoi(argv[2]), list_file_name);
+      exit(0);
+   }
+
   // If PlayVideo is already running, exit immediately.
    ExecuteCommand CMD;
    string grepResult = CMD.execute("ps ax | grep PlayVideo | grep -v grep | grep -v lxterminal");
@@ -192,6 +303,12 @@ int main()  {
    // Initialize Pushbuttons: set up input pins with pull-ups
    cout << "Initialize buttons" << endl;
    wiringPiSetupGpio ();
+   char *zone_file_name=getenv(ZONE_FILE_ENV_VAR);
+   if (zone_file_name != NULL) {
+      pinMode(FAST_DEBOUNCE,INPUT);
+      pullUpDnControl(FAST_DEBOUNCE,PUD_UP);
+      runZones(zone_file_name);
+   }
    pinMode(FORWARD_BUTTON,INPUT);
    pinMode(REVERSE_BUTTON,INPUT);
    pinMode(FAST_DEBOUNCE,INPUT);
@@ -250,11 +367,15 @@ int main()  {
    // We give ListManager the location of the list file and player
    cout << "Fetching list of videos" << endl;
    LM.initialize(list_file_name);
+   ListManager *lists[1] = { &LM };
+   startLibraryServices(lists, 1);
 
    // START FIRST VIDEO
    PlayVideo play;
    videospec_t video;
    play.initialize(player_file_name, PlayerOptions);  //  video player and options
+   if (use_cache) play.useCache(&cache, 0);
+   if (use_index) play.useMediaIndex(&media);
    video = LM.currentVideo();  // get the first video file name
    forwardButtonFlag=0;
    reverseButtonFlag=0;